@@ -63,6 +63,7 @@ module xcfun
 
   private :: fstring_to_carray
   private :: text_handler
+  private :: c_distance
 
   interface
     function xcfun_version_C() result(text) &
@@ -83,6 +84,12 @@ module xcfun
       type(c_ptr) :: text
     end function
 
+    function xcfun_kernel_isa_C() result(text) &
+         bind(C, name="xcfun_kernel_isa")
+      import
+      type(c_ptr) :: text
+    end function
+
     function xcfun_test_C() result(nfail) &
          bind(C, name="xcfun_test")
       import
@@ -172,6 +179,79 @@ module xcfun
       integer(c_int) :: err
     end function
 
+    function xcfun_set_lda_tables_C(fun, tolerance) result(err) &
+      bind(C, name="xcfun_set_lda_tables")
+      import
+      type(c_ptr), intent(in), value :: fun
+      real(c_double), intent(in), value :: tolerance
+      integer(c_int) :: err
+    end function
+
+    function xcfun_set_single_precision_C(fun, single) result(err) &
+      bind(C, name="xcfun_set_single_precision")
+      import
+      type(c_ptr), intent(in), value :: fun
+      logical(c_bool), intent(in), value :: single
+      integer(c_int) :: err
+    end function
+
+    function xcfun_set_spin_symmetry_C(fun, symmetric) result(err) &
+      bind(C, name="xcfun_set_spin_symmetry")
+      import
+      type(c_ptr), intent(in), value :: fun
+      logical(c_bool), intent(in), value :: symmetric
+      integer(c_int) :: err
+    end function
+
+    function xcfun_set_generated_kernels_C(fun, generated) result(err) &
+      bind(C, name="xcfun_set_generated_kernels")
+      import
+      type(c_ptr), intent(in), value :: fun
+      logical(c_bool), intent(in), value :: generated
+      integer(c_int) :: err
+    end function
+
+    function xcfun_uses_generated_kernels_C(fun) result(uses) &
+      bind(C, name="xcfun_uses_generated_kernels")
+      import
+      type(c_ptr), intent(in), value :: fun
+      logical(c_bool) :: uses
+    end function
+
+    function xcfun_set_jit_C(fun, jit) result(err) &
+      bind(C, name="xcfun_set_jit")
+      import
+      type(c_ptr), intent(in), value :: fun
+      logical(c_bool), intent(in), value :: jit
+      integer(c_int) :: err
+    end function
+
+    function xcfun_uses_jit_C(fun) result(uses) &
+      bind(C, name="xcfun_uses_jit")
+      import
+      type(c_ptr), intent(in), value :: fun
+      logical(c_bool) :: uses
+    end function
+
+    function xcfun_get_profile_C(fun, name, mode, order, points, calls, cycles) &
+         result(err) bind(C, name="xcfun_get_profile")
+      import
+      type(c_ptr), intent(in), value :: fun
+      character(kind=c_char, len=1), intent(in) :: name(*)
+      integer(kind(XC_MODE_UNSET)), intent(in), value :: mode
+      integer(c_int), intent(in), value :: order
+      integer(c_long_long), intent(out) :: points
+      integer(c_long_long), intent(out) :: calls
+      integer(c_long_long), intent(out) :: cycles
+      integer(c_int) :: err
+    end function
+
+    subroutine xcfun_reset_profile(fun) &
+      bind(C)
+      import
+      type(c_ptr), value :: fun
+    end subroutine
+
     function xcfun_is_gga_C(fun) result(is_gga) &
       bind(C, name="xcfun_is_gga")
       import
@@ -236,6 +316,122 @@ module xcfun
       real(c_double), intent(inout) :: res(*)
       integer(c_int), intent(in), value :: r_pitch
     end subroutine
+
+    function xcfun_try_eval(fun, density, res) result(err) &
+         bind(C)
+      import
+      type(c_ptr), intent(in), value :: fun
+      real(c_double), intent(in) :: density(*)
+      real(c_double), intent(inout) :: res(*)
+      integer(c_int) :: err
+    end function
+
+    function xcfun_try_eval_vec(fun, nr_points, density, d_pitch, res, r_pitch) &
+         result(err) bind(C)
+      import
+      type(c_ptr), intent(in), value :: fun
+      integer(c_int), intent(in), value :: nr_points
+      real(c_double), intent(in) :: density(*)
+      integer(c_int), intent(in), value :: d_pitch
+      real(c_double), intent(inout) :: res(*)
+      integer(c_int), intent(in), value :: r_pitch
+      integer(c_int) :: err
+    end function
+
+    ! planes holds order + 1 pointers, see the C documentation for the layout
+    function xcfun_eval_vec_planes(fun, nr_points, density, d_pitch, planes, &
+         p_pitch) result(err) bind(C)
+      import
+      type(c_ptr), intent(in), value :: fun
+      integer(c_int), intent(in), value :: nr_points
+      real(c_double), intent(in) :: density(*)
+      integer(c_int), intent(in), value :: d_pitch
+      type(c_ptr), intent(in) :: planes(*)
+      integer(c_int), intent(in), value :: p_pitch
+      integer(c_int) :: err
+    end function
+
+    ! nr_perturbations blocks of input length per point in perturbed and res
+    function xcfun_eval_kernel_contraction(fun, nr_points, density, d_pitch, &
+         nr_perturbations, perturbed, p_pitch, res, r_pitch) result(err) bind(C)
+      import
+      type(c_ptr), intent(in), value :: fun
+      integer(c_int), intent(in), value :: nr_points
+      real(c_double), intent(in) :: density(*)
+      integer(c_int), intent(in), value :: d_pitch
+      integer(c_int), intent(in), value :: nr_perturbations
+      real(c_double), intent(in) :: perturbed(*)
+      integer(c_int), intent(in), value :: p_pitch
+      real(c_double), intent(inout) :: res(*)
+      integer(c_int), intent(in), value :: r_pitch
+      integer(c_int) :: err
+    end function
+
+    ! 1 + 2*input length results per point: energy, gradient, Hessian times
+    ! direction
+    function xcfun_eval_hessian_vector(fun, nr_points, density, d_pitch, &
+         direction, v_pitch, res, r_pitch) result(err) bind(C)
+      import
+      type(c_ptr), intent(in), value :: fun
+      integer(c_int), intent(in), value :: nr_points
+      real(c_double), intent(in) :: density(*)
+      integer(c_int), intent(in), value :: d_pitch
+      real(c_double), intent(in) :: direction(*)
+      integer(c_int), intent(in), value :: v_pitch
+      real(c_double), intent(inout) :: res(*)
+      integer(c_int), intent(in), value :: r_pitch
+      integer(c_int) :: err
+    end function
+
+    ! electrons is c_loc of a real(c_double) target, or c_null_ptr
+    function xcfun_eval_integrate(fun, nr_points, density, d_pitch, weights, &
+         energy, electrons) result(err) bind(C)
+      import
+      type(c_ptr), intent(in), value :: fun
+      integer(c_int), intent(in), value :: nr_points
+      real(c_double), intent(in) :: density(*)
+      integer(c_int), intent(in), value :: d_pitch
+      real(c_double), intent(in) :: weights(*)
+      real(c_double), intent(out) :: energy
+      type(c_ptr), intent(in), value :: electrons
+      integer(c_int) :: err
+    end function
+
+    function xcfun_eval_vec_weighted(fun, nr_points, density, d_pitch, weights, &
+         res, r_pitch) result(err) bind(C)
+      import
+      type(c_ptr), intent(in), value :: fun
+      integer(c_int), intent(in), value :: nr_points
+      real(c_double), intent(in) :: density(*)
+      integer(c_int), intent(in), value :: d_pitch
+      real(c_double), intent(in) :: weights(*)
+      real(c_double), intent(inout) :: res(*)
+      integer(c_int), intent(in), value :: r_pitch
+      integer(c_int) :: err
+    end function
+
+    ! One flag per output, nonzero for the partial derivatives to compute
+    function xcfun_set_output_mask(fun, mask) result(err) bind(C)
+      import
+      type(c_ptr), intent(in), value :: fun
+      integer(c_int), intent(in) :: mask(*)
+      integer(c_int) :: err
+    end function
+
+    ! Explicit pitch and stride between variables, in doubles. Nothing is
+    ! copied, density and res point to the first variable of the first point.
+    subroutine xcfun_eval_vec_strided(fun, nr_points, density, d_pitch, d_stride, &
+         res, r_pitch, r_stride) bind(C)
+      import
+      type(c_ptr), intent(in), value :: fun
+      integer(c_int), intent(in), value :: nr_points
+      type(c_ptr), intent(in), value :: density
+      integer(c_int), intent(in), value :: d_pitch
+      integer(c_int), intent(in), value :: d_stride
+      type(c_ptr), intent(in), value :: res
+      integer(c_int), intent(in), value :: r_pitch
+      integer(c_int), intent(in), value :: r_stride
+    end subroutine
   end interface
 
   interface xcfun_eval_setup
@@ -352,6 +548,12 @@ contains
     text = text_handler(xcfun_authors_C(), 5000)
   end function
 
+  function xcfun_kernel_isa() result(text)
+    character(kind=c_char, len=50) :: text
+
+    text = text_handler(xcfun_kernel_isa_C(), 50)
+  end function
+
   function xcfun_enumerate_parameters(n) result(text)
     integer, intent(in) :: n
     character(kind=c_char, len=5000) :: text
@@ -398,6 +600,75 @@ contains
     err = int(xcfun_get_C(fun, fstring_to_carray(param), val))
   end function
 
+  function xcfun_set_lda_tables(fun, tolerance) result(err)
+    type(c_ptr), intent(in), value :: fun
+    real(c_double), intent(in) :: tolerance
+    integer :: err
+
+    err = int(xcfun_set_lda_tables_C(fun, tolerance))
+  end function
+
+  function xcfun_set_single_precision(fun, single) result(err)
+    type(c_ptr), intent(in), value :: fun
+    logical, intent(in) :: single
+    integer :: err
+
+    err = int(xcfun_set_single_precision_C(fun, logical(single, kind=c_bool)))
+  end function
+
+  function xcfun_set_spin_symmetry(fun, symmetric) result(err)
+    type(c_ptr), intent(in), value :: fun
+    logical, intent(in) :: symmetric
+    integer :: err
+
+    err = int(xcfun_set_spin_symmetry_C(fun, logical(symmetric, kind=c_bool)))
+  end function
+
+  function xcfun_set_generated_kernels(fun, generated) result(err)
+    type(c_ptr), intent(in), value :: fun
+    logical, intent(in) :: generated
+    integer :: err
+
+    err = int(xcfun_set_generated_kernels_C(fun, logical(generated, kind=c_bool)))
+  end function
+
+  function xcfun_uses_generated_kernels(fun) result(uses)
+    type(c_ptr), intent(in), value :: fun
+    logical :: uses
+
+    uses = logical(xcfun_uses_generated_kernels_C(fun))
+  end function
+
+  function xcfun_set_jit(fun, jit) result(err)
+    type(c_ptr), intent(in), value :: fun
+    logical, intent(in) :: jit
+    integer :: err
+
+    err = int(xcfun_set_jit_C(fun, logical(jit, kind=c_bool)))
+  end function
+
+  function xcfun_uses_jit(fun) result(uses)
+    type(c_ptr), intent(in), value :: fun
+    logical :: uses
+
+    uses = logical(xcfun_uses_jit_C(fun))
+  end function
+
+  function xcfun_get_profile(fun, name, mode, order, points, calls, cycles) &
+       result(err)
+    type(c_ptr), intent(in), value :: fun
+    character(kind=c_char, len=*), intent(in) :: name
+    integer(kind(XC_MODE_UNSET)), intent(in) :: mode
+    integer, intent(in) :: order
+    integer(c_long_long), intent(out) :: points
+    integer(c_long_long), intent(out) :: calls
+    integer(c_long_long), intent(out) :: cycles
+    integer :: err
+
+    err = int(xcfun_get_profile_C(fun, fstring_to_carray(name), mode, &
+                                  int(order, kind=c_int), points, calls, cycles))
+  end function
+
   function xcfun_is_gga(fun) result(is_gga)
     type(c_ptr), intent(in), value :: fun
     logical :: is_gga
@@ -467,19 +738,38 @@ contains
     err = int(xcfun_user_eval_setup_C(fun, o, f, d, m, l, k, c, e))
   end function
 
+  ! \brief Distance in doubles from a to b, elements of the same array.
+  function c_distance(a, b) result(d)
+    real(c_double), intent(in), target :: a
+    real(c_double), intent(in), target :: b
+    integer(c_int) :: d
+
+    d = int((transfer(c_loc(b), 0_c_intptr_t) - transfer(c_loc(a), 0_c_intptr_t)) &
+            / c_sizeof(a), kind=c_int)
+  end function
+
+  ! Array sections are evaluated in place, with the strides read from the
+  ! element addresses, instead of through a contiguous temporary copy.
   subroutine xcfun_eval_vec(fun, nr_points, density, res)
     type(c_ptr), intent(in), value :: fun
     integer, intent(in) :: nr_points
-    real(c_double), intent(in) :: density(:, :)
-    real(c_double), intent(inout) :: res(:, :)
-
-    integer(c_int) :: n
-    integer(c_int) :: d_pitch
-    integer(c_int) :: r_pitch
-
-    n = int(nr_points)
-    d_pitch = int(size(density(:,1)), kind=c_int)
-    r_pitch = int(size(res(:,1)), kind=c_int)
-    call xcfun_eval_vec_C(fun, n, density, d_pitch, res, r_pitch)
+    real(c_double), intent(in), target :: density(:, :)
+    real(c_double), intent(inout), target :: res(:, :)
+
+    integer(c_int) :: d_pitch, d_stride
+    integer(c_int) :: r_pitch, r_stride
+
+    if (nr_points < 1) return
+    d_stride = 1
+    r_stride = 1
+    d_pitch = 0
+    r_pitch = 0
+    if (size(density, 1) > 1) d_stride = c_distance(density(1, 1), density(2, 1))
+    if (size(res, 1) > 1) r_stride = c_distance(res(1, 1), res(2, 1))
+    if (size(density, 2) > 1) d_pitch = c_distance(density(1, 1), density(1, 2))
+    if (size(res, 2) > 1) r_pitch = c_distance(res(1, 1), res(1, 2))
+    call xcfun_eval_vec_strided(fun, int(nr_points, kind=c_int), &
+                                c_loc(density(1, 1)), d_pitch, d_stride, &
+                                c_loc(res(1, 1)), r_pitch, r_stride)
   end subroutine
 end module
@@ -142,6 +142,16 @@ XCFun_API const char * xcfun_splash();
  */
 XCFun_API const char * xcfun_authors();
 
+/*! \brief Instruction set of the functional kernels in use
+ *  \return `"generic"`, or one of `"sse4.2"`, `"avx2"` and `"avx512"` when the
+ *  library was compiled with `XCFUN_ENABLE_ISA_DISPATCH`.
+ *
+ *  The best instruction set supported by the CPU is selected when the first
+ *  functional is created. Set the environment variable `XCFUN_ISA` to one of
+ *  the names above to select another one.
+ */
+XCFun_API const char * xcfun_kernel_isa();
+
 /*! \brief Test XCFun
  *  \return the number of failed tests.
  *
@@ -293,6 +303,132 @@ XCFun_API int xcfun_set(xcfun_t * fun, const char * name, double value);
  */
 XCFun_API int xcfun_get(const xcfun_t * fun, const char * name, double * value);
 
+/*! \brief Evaluate pure density functionals from interpolation tables
+ *  \param[in, out] fun the functional object
+ *  \param[in] tolerance relative error bound of the tabulated energy density,
+ *  `0` switches back to the analytic kernels
+ *  \return `0` on success, `-1` if `tolerance` is negative
+ *
+ *  The tables are built by `xcfun_eval_setup` for the active LDA terms where
+ *  they are faster than the analytic kernels: `vwn5c` at every order, `pw92c`
+ *  from second and `vwn3c` from third order (Taylor order of the kernel calls,
+ *  which is 2 for first order partial derivatives). They cover
+ *  \f$ 10^{-3} < r_s < 10^3 \f$ and \f$ |\zeta| < 0.9 \f$. Points outside
+ *  this range, and terms that cannot be tabulated to the requested accuracy,
+ *  use the analytic kernels. Derivatives are those of the interpolant and lose
+ *  accuracy with their order: with `tolerance` 1e-10 the relative error of
+ *  the first derivatives is about 1e-8, of the second 1e-5 and of the third
+ *  1e-3 near \f$ |\zeta| = 0.9 \f$.
+ */
+XCFun_API int xcfun_set_lda_tables(xcfun_t * fun, double tolerance);
+
+/*! \brief Evaluation counters of one term of the functional
+ *  \param[in] fun the functional object
+ *  \param[in] name name of an active functional, not an alias
+ *  \param[in] mode evaluation mode
+ *  \param[in] order order given to `xcfun_eval_setup`
+ *  \param[out] points number of points evaluated
+ *  \param[out] calls number of kernel calls, several per point for
+ *  derivatives
+ *  \param[out] cycles time spent in the kernel calls, in time stamp counter
+ *  cycles on x86 and nanoseconds elsewhere
+ *  \return `0` on success, `-1` if the library was compiled without
+ *  `XCFUN_ENABLE_PROFILING`, `name` is not a functional, or `mode` or `order`
+ *  are out of range
+ *
+ *  The counters are accumulated by `xcfun_eval` and `xcfun_eval_vec` since
+ *  the functional was created or `xcfun_reset_profile` was last called.
+ */
+XCFun_API int xcfun_get_profile(const xcfun_t * fun,
+                                const char * name,
+                                xcfun_mode mode,
+                                int order,
+                                unsigned long long * points,
+                                unsigned long long * calls,
+                                unsigned long long * cycles);
+
+/*! \brief Set all evaluation counters to zero
+ *  \param[in, out] fun the functional object
+ *
+ *  Not to be called while other threads evaluate the functional.
+ */
+XCFun_API void xcfun_reset_profile(xcfun_t * fun);
+
+/*! \brief Evaluate the functional kernels in single precision
+ *  \param[in, out] fun the functional object
+ *  \param[in] single whether to use the single precision kernels
+ *  \return `0` on success, `-1` if the library was compiled without
+ *  `XCFUN_ENABLE_SINGLE`
+ *
+ *  Inputs, outputs and the sum over functionals stay in double precision.
+ *  Expect relative errors of about \f$ 10^{-6} \f$, and larger for high order
+ *  derivatives.
+ */
+XCFun_API int xcfun_set_single_precision(xcfun_t * fun, bool single);
+
+/*! \brief Exploit the alpha/beta symmetry of closed-shell points
+ *  \param[in, out] fun the functional object
+ *  \param[in] symmetric whether to look for spin symmetric points
+ *  \return `0` on success, `-1` if the evaluation set up with
+ *  `xcfun_eval_setup` is not of partial derivatives of the `XC_A_B` family
+ *  of variables, in which case the setting is left unchanged
+ *
+ *  With partial derivatives of the `XC_A_B` family of variables, points
+ *  where every alpha input equals its beta counterpart then only compute
+ *  one of each pair of derivatives related by exchanging alpha and beta,
+ *  and copy it to the other. Other points are evaluated as usual, and so are
+ *  other variables set up after enabling the symmetry.
+ */
+XCFun_API int xcfun_set_spin_symmetry(xcfun_t * fun, bool symmetric);
+
+/*! \brief Use the kernels generated at build time for partial derivatives
+ *  \param[in, out] fun the functional object
+ *  \param[in] generated whether to use the generated kernels
+ *  \return `0`, or `-1` if the library was built without `XCFUN_ENABLE_CODEGEN`
+ *
+ *  The generated kernels are straight-line code for the energy, gradient
+ *  and Hessian of each functional, traced from the Taylor kernels with the
+ *  `XC_N`, `XC_A_B`, `XC_N_GNN`, `XC_A_B_GAA_GAB_GBB`, `XC_N_GNN_TAUN` and
+ *  `XC_A_B_GAA_GAB_GBB_TAUA_TAUB` variables. Functionals that branch on the
+ *  density or read parameters have no generated kernels, and setups using
+ *  them, or other variables, modes and orders, keep the Taylor kernels.
+ */
+XCFun_API int xcfun_set_generated_kernels(xcfun_t * fun, bool generated);
+
+/*! \brief Does the current setup use the generated kernels?
+ *  \param[in] fun the functional object
+ *  \return Whether `xcfun_eval` goes through the generated kernels
+ */
+XCFun_API bool xcfun_uses_generated_kernels(const xcfun_t * fun);
+
+/*! \brief Compile a kernel for the functional mixture at run time
+ *  \param[in, out] fun the functional object
+ *  \param[in] jit whether to use kernels compiled at run time
+ *  \return `0`, or `-1` if the library was built without `XCFUN_ENABLE_JIT`
+ *
+ *  `xcfun_eval_setup` then traces the sum of the functionals, with their
+ *  weights and parameters as constants, and compiles the energy, gradient
+ *  or Hessian into a shared library with the C++ compiler of the build.
+ *  Libraries are cached on disk under a hash of the setup, in
+ *  `XCFUN_JIT_CACHE` or else `$XDG_CACHE_HOME/xcfun` or `$HOME/.cache/xcfun`,
+ *  and are loaded without compiling when the same setup is used again.
+ *  `XCFUN_JIT_CXX` and `XCFUN_JIT_FLAGS` override the compiler and its
+ *  optimization flags, `XCFUN_JIT_INCLUDE` the headers installed to
+ *  `include/XCFun/jit`. Partial derivatives up to second order with the
+ *  variables of `xcfun_set_generated_kernels` are supported; other setups,
+ *  functionals that branch on the density, and failed compilations keep
+ *  the Taylor kernels. `xcfun_set` also returns to the Taylor kernels,
+ *  until the next `xcfun_eval_setup` compiles the new weights and
+ *  parameters.
+ */
+XCFun_API int xcfun_set_jit(xcfun_t * fun, bool jit);
+
+/*! \brief Does the current setup use a kernel compiled at run time?
+ *  \param[in] fun the functional object
+ *  \return Whether `xcfun_eval` goes through the compiled kernel
+ */
+XCFun_API bool xcfun_uses_jit(const xcfun_t * fun);
+
 /*! \brief Is the XC functional GGA?
  *  \param[in, out] fun
  *  \return Whether `fun` is a GGA-type functional
@@ -385,6 +521,233 @@ XCFun_API void xcfun_eval_vec(const xcfun_t * fun,
                               int density_pitch,
                               double * result,
                               int result_pitch);
+
+/*! \brief Evaluate partial derivatives on a set of points into one
+ *  plane per derivative order
+ *  \param[in] fun XC functional object
+ *  \param[in] nr_points number of points in the evaluation set
+ *  \param[in] density
+ *  \param[in] density_pitch
+ *  \param[out] planes `order + 1` arrays, the derivatives of order `k` go
+ *  to `planes[k]`. A null plane is not written.
+ *  \param[in] plane_pitch distance between two rows of a plane, at least
+ *  `nr_points`
+ *  \return `0` on success, `-1` if not set up for partial derivatives or
+ *  `plane_pitch` is too small, `XC_ESETUP` (8) if there is no valid
+ *  evaluation setup
+ *
+ *  Plane `k` has one row for each derivative of order `k`, in the order of
+ *  the `xcfun_eval` output, and one column for each point. Element
+ *  `planes[k][c * plane_pitch + p]` is component `c` of point `p`, so each
+ *  plane is a column-major `nr_points` by components matrix with leading
+ *  dimension `plane_pitch`, ready for GEMM. With 16-byte aligned planes and
+ *  an even `plane_pitch`, the planes are written with non-temporal stores
+ *  and do not pass through the cache. Rows of outputs left out with
+ *  `xcfun_set_output_mask` are not written.
+ */
+XCFun_API int xcfun_eval_vec_planes(const xcfun_t * fun,
+                                    int nr_points,
+                                    const double * density,
+                                    int density_pitch,
+                                    double * planes[],
+                                    int plane_pitch);
+
+/*! \brief Contract the second derivatives with perturbed densities on a
+ *  set of points, without forming the second derivatives
+ *  \param[in] fun XC functional object, set up for second order partial
+ *  derivatives
+ *  \param[in] nr_points number of points in the evaluation set
+ *  \param[in] density
+ *  \param[in] density_pitch
+ *  \param[in] nr_perturbations number of perturbed densities at each point
+ *  \param[in] perturbed `nr_perturbations` blocks of
+ *  `xcfun_input_length` numbers for each point
+ *  \param[in] perturbed_pitch distance between the first blocks of two
+ *  consecutive points
+ *  \param[out] result `nr_perturbations` blocks of `xcfun_input_length`
+ *  numbers for each point
+ *  \param[in] result_pitch distance between the first blocks of two
+ *  consecutive points
+ *  \return `0` on success, `-1` if not set up for second order partial
+ *  derivatives, `XC_ESETUP` (8) if there is no valid evaluation setup
+ *
+ *  A perturbed density block holds the first order change of each input
+ *  variable, for example \f$ \rho_1 \f$ and \f$ \nabla\rho_1 \f$ with
+ *  `XC_N_NX_NY_NZ`. The matching result block is
+ *  \f$ v_{1,i} = \sum_j \frac{\partial^2 E}{\partial x_i \partial x_j}
+ *  \rho_{1,j} \f$, where the chain rule through the gradient invariants is
+ *  included by the evaluation. Each perturbation is a Hessian-vector
+ *  product as in `xcfun_eval_hessian_vector`, compared to one kernel
+ *  evaluation per element of the upper triangle of the second derivatives
+ *  with `xcfun_eval`.
+ */
+XCFun_API int xcfun_eval_kernel_contraction(const xcfun_t * fun,
+                                            int nr_points,
+                                            const double * density,
+                                            int density_pitch,
+                                            int nr_perturbations,
+                                            const double * perturbed,
+                                            int perturbed_pitch,
+                                            double * result,
+                                            int result_pitch);
+
+/*! \brief Evaluate the gradient and the second derivatives times a
+ *  direction on a set of points
+ *  \param[in] fun XC functional object, set up for second order partial
+ *  derivatives
+ *  \param[in] nr_points number of points in the evaluation set
+ *  \param[in] density
+ *  \param[in] density_pitch
+ *  \param[in] direction `xcfun_input_length` numbers for each point
+ *  \param[in] direction_pitch
+ *  \param[out] result `1 + 2*xcfun_input_length` numbers for each point
+ *  \param[in] result_pitch
+ *  \return `0` on success, `-1` if not set up for second order partial
+ *  derivatives, `XC_ESETUP` (8) if there is no valid evaluation setup
+ *
+ *  The result of a point is the energy, the first derivatives
+ *  \f$ \partial E / \partial x_i \f$ and then
+ *  \f$ \sum_j \frac{\partial^2 E}{\partial x_i \partial x_j} v_j \f$ for the
+ *  direction \f$ v \f$. They come from one forward and one backward sweep
+ *  over the kernels, without forming the second derivatives. In single
+ *  precision or with LDA tables it takes one pass per variable instead.
+ */
+XCFun_API int xcfun_eval_hessian_vector(const xcfun_t * fun,
+                                        int nr_points,
+                                        const double * density,
+                                        int density_pitch,
+                                        const double * direction,
+                                        int direction_pitch,
+                                        double * result,
+                                        int result_pitch);
+
+/*! \brief Integrate the energy over a set of points
+ *  \param[in] fun XC functional object
+ *  \param[in] nr_points number of points in the evaluation set
+ *  \param[in] density
+ *  \param[in] density_pitch
+ *  \param[in] weights quadrature weight of each point
+ *  \param[out] energy \f$ \sum_p w_p E_p \f$
+ *  \param[out] electrons \f$ \sum_p w_p n_p \f$, the integrated number of
+ *  electrons in the density input, only alpha for the alpha vars, or `NULL`
+ *  if not needed
+ *  \return `0` on success, `XC_ESETUP` (8) if there is no valid evaluation
+ *  setup, `XC_EORDER` (1) if the energy kernels were not compiled
+ *
+ *  Only the energy is evaluated, whatever the order and mode of the setup,
+ *  and nothing is written per point. The sums are compensated, and taken
+ *  over blocks of 256 points before the block sums are added in order. The
+ *  result does not depend on how the points are split between calls or
+ *  threads, as long as each part is summed over whole blocks.
+ */
+XCFun_API int xcfun_eval_integrate(const xcfun_t * fun,
+                                   int nr_points,
+                                   const double * density,
+                                   int density_pitch,
+                                   const double * weights,
+                                   double * energy,
+                                   double * electrons);
+
+/*! \brief Evaluate the XC functional on a set of points, multiplied by
+ *  quadrature weights
+ *  \param[in] fun XC functional object
+ *  \param[in] nr_points number of points in the evaluation set
+ *  \param[in] density
+ *  \param[in] density_pitch
+ *  \param[in] weights weight of each point
+ *  \param[out] result
+ *  \param[in] result_pitch
+ *  \return `0` on success, `XC_ESETUP` (8) if there is no valid evaluation
+ *  setup
+ *
+ *  Like `xcfun_eval_vec`, with every output of point `p` multiplied by
+ *  `weights[p]` before it is stored. The result can go to the basis
+ *  function contraction without another pass to apply the weights.
+ */
+XCFun_API int xcfun_eval_vec_weighted(const xcfun_t * fun,
+                                      int nr_points,
+                                      const double * density,
+                                      int density_pitch,
+                                      const double * weights,
+                                      double * result,
+                                      int result_pitch);
+
+/*! \brief Select the partial derivatives to compute
+ *  \param[in, out] fun XC functional object
+ *  \param[in] mask `xcfun_output_length` flags, nonzero for the outputs to
+ *  compute, or `NULL` to compute all of them
+ *  \return `0` on success, `-1` if the functional is not set up for partial
+ *  derivatives
+ *
+ *  The mask is indexed like the output of `xcfun_eval`. Evaluations then
+ *  skip the derivative passes which only give unselected outputs, and leave
+ *  those outputs unwritten. `xcfun_eval_setup` clears the mask, so call this
+ *  after it.
+ */
+XCFun_API int xcfun_set_output_mask(xcfun_t * fun, const int mask[]);
+
+/*! \brief Evaluate the XC functional at a point, without terminating the
+ *  process on errors.
+ *  \param[in] fun XC functional object
+ *  \param[in] density
+ *  \param[in, out] result
+ *  \return `0` on success, `XC_ESETUP` (8) if there is no valid evaluation
+ *  setup
+ *
+ *  `xcfun_eval_setup` checks everything the evaluation depends on, so once
+ *  it succeeded the evaluation cannot fail. The setup becomes invalid when a
+ *  functional is added with `xcfun_set` afterwards. Unlike `xcfun_eval`,
+ *  this function then returns an error instead of calling `exit`.
+ */
+XCFun_API int xcfun_try_eval(const xcfun_t * fun,
+                             const double density[],
+                             double result[]);
+
+/*! \brief Evaluate the XC functional on a set of points, without
+ *  terminating the process on errors.
+ *  \param[in] fun XC functional object
+ *  \param[in] nr_points number of points in the evaluation set
+ *  \param[in] density
+ *  \param[in] density_pitch
+ *  \param[in, out] result
+ *  \param[in] result_pitch
+ *  \return `0` on success, `XC_ESETUP` (8) if there is no valid evaluation
+ *  setup, in which case nothing is evaluated
+ *
+ *  See `xcfun_eval_vec` and `xcfun_try_eval`.
+ */
+XCFun_API int xcfun_try_eval_vec(const xcfun_t * fun,
+                                 int nr_points,
+                                 const double * density,
+                                 int density_pitch,
+                                 double * result,
+                                 int result_pitch);
+
+/*! \brief Evaluate the XC functional on a set of points in strided arrays.
+ *  \param[in] fun XC functional object
+ *  \param[in] nr_points number of points in the evaluation set
+ *  \param[in] density
+ *  \param[in] density_pitch distance between the first variables of two
+ *  consecutive points
+ *  \param[in] density_stride distance between two variables of a point
+ *  \param[in, out] result
+ *  \param[in] result_pitch distance between the first outputs of two
+ *  consecutive points
+ *  \param[in] result_stride distance between two outputs of a point
+ *
+ *  Distances are counted in doubles and may be negative, so that any
+ *  two-dimensional array view can be evaluated in place. With unit strides
+ *  this is `xcfun_eval_vec`. Different point ranges may be evaluated by
+ *  several threads at the same time.
+ */
+XCFun_API void xcfun_eval_vec_strided(const xcfun_t * fun,
+                                      int nr_points,
+                                      const double * density,
+                                      int density_pitch,
+                                      int density_stride,
+                                      double * result,
+                                      int result_pitch,
+                                      int result_stride);
 #ifdef __cplusplus
 } // End of extern "C"
 #endif
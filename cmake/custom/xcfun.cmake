@@ -5,15 +5,37 @@
 # Variables modified::
 #
 #   XCFUN_MAX_ORDER -- Maximum order of derivatives of the exchange-correlation kernel
+#   XCFUN_ENABLE_SINGLE -- Whether to also compile single precision kernels
+#   XCFUN_ENABLE_ISA_DISPATCH -- Whether to compile kernels for several x86 instruction sets
+#   XCFUN_ENABLE_PROFILING -- Whether to count evaluations and kernel cycles per functional
+#   XCFUN_ENABLE_VECTOR_MATH -- Whether to use the in-tree exp, log and pow in the kernels
+#   XCFUN_ENABLE_CODEGEN -- Whether to generate straight-line kernels for partial derivatives
+#   XCFUN_ENABLE_JIT -- Whether to compile kernels for functional mixtures at run time
+#   XCFUN_FUNCTIONALS -- Functionals to compile, all if empty
+#   XCFUN_{LDA,GGA,MGGA}_{MIN,MAX}_ORDER -- Range of kernel orders to compile for each family
 #   XCFUN_PYTHON_INTERFACE -- Whether to enable the Python interface
 #
 # autocmake.yml configuration::
 #
 #   docopt:
 #     - "--xcmaxorder=<XCFUN_MAX_ORDER> An integer greater than 3 [default: 6]."
+#     - "--single Compile single precision kernels [default: OFF]."
+#     - "--isa-dispatch Compile kernels for several instruction sets [default: OFF]."
+#     - "--profiling Count evaluations and kernel cycles per functional [default: OFF]."
+#     - "--vector-math Use the in-tree exp, log and pow in the kernels [default: OFF]."
+#     - "--codegen Generate straight-line kernels for partial derivatives [default: OFF]."
+#     - "--jit Compile kernels for functional mixtures at run time [default: OFF]."
+#     - "--functionals=<XCFUN_FUNCTIONALS> Semicolon separated list of functionals to compile, all if empty [default: '']."
 #     - "--pybindings Enable Python interface [default: OFF]."
 #   define:
 #     - "'-DXCFUN_MAX_ORDER=\"{0}\"'.format(arguments['--xcmaxorder'])"
+#     - "'-DXCFUN_ENABLE_SINGLE={0}'.format(arguments['--single'])"
+#     - "'-DXCFUN_ENABLE_ISA_DISPATCH={0}'.format(arguments['--isa-dispatch'])"
+#     - "'-DXCFUN_ENABLE_PROFILING={0}'.format(arguments['--profiling'])"
+#     - "'-DXCFUN_ENABLE_VECTOR_MATH={0}'.format(arguments['--vector-math'])"
+#     - "'-DXCFUN_ENABLE_CODEGEN={0}'.format(arguments['--codegen'])"
+#     - "'-DXCFUN_ENABLE_JIT={0}'.format(arguments['--jit'])"
+#     - "'-DXCFUN_FUNCTIONALS=\"{0}\"'.format(arguments['--functionals'])"
 #     - "'-DXCFUN_PYTHON_INTERFACE={0}'.format(arguments['--pybindings'])"
 
 option_with_default(XCFUN_MAX_ORDER "Maximum order of derivatives of the exchange-correlation kernel" 6)
@@ -23,6 +45,44 @@ if(DEFINED XCFUN_MAX_ORDER AND XCFUN_MAX_ORDER LESS 3)
   set(XCFUN_MAX_ORDER 6 CACHE STRING "Maximum order of derivatives of the exchange-correlation kernel" FORCE)
 endif()
 
+option_with_print(XCFUN_ENABLE_SINGLE "Compile single precision kernels, selectable at run time" OFF)
+option_with_print(XCFUN_ENABLE_ISA_DISPATCH "Compile kernels for SSE4.2, AVX2 and AVX-512, selected at run time" OFF)
+if(XCFUN_ENABLE_ISA_DISPATCH)
+  # Needs GNU-style partial linking and objcopy, and __builtin_cpu_supports
+  if(NOT (CMAKE_CXX_COMPILER_ID MATCHES "GNU|Clang") OR
+     NOT CMAKE_SYSTEM_PROCESSOR MATCHES "x86_64|AMD64|amd64" OR
+     APPLE OR WIN32 OR NOT CMAKE_OBJCOPY)
+    message(STATUS "Instruction set dispatch is not supported on this platform, disabling it")
+    set(XCFUN_ENABLE_ISA_DISPATCH OFF CACHE BOOL "Compile kernels for SSE4.2, AVX2 and AVX-512, selected at run time" FORCE)
+  endif()
+endif()
+
+option_with_print(XCFUN_ENABLE_PROFILING "Count evaluations and kernel cycles per functional" OFF)
+option_with_print(XCFUN_ENABLE_VECTOR_MATH "Use the in-tree exp, log and pow in the kernels" OFF)
+option_with_print(XCFUN_ENABLE_CODEGEN "Generate straight-line kernels for partial derivatives, selectable at run time" OFF)
+if(XCFUN_ENABLE_CODEGEN AND CMAKE_CROSSCOMPILING)
+  # The generator runs on the build machine
+  message(STATUS "Kernel generation is not supported when cross compiling, disabling it")
+  set(XCFUN_ENABLE_CODEGEN OFF CACHE BOOL "Generate straight-line kernels for partial derivatives, selectable at run time" FORCE)
+endif()
+option_with_print(XCFUN_ENABLE_JIT "Allow compiling kernels for functional mixtures at run time" OFF)
+if(XCFUN_ENABLE_JIT AND NOT UNIX)
+  # Needs dlopen and a compiler taking GNU-style options
+  message(STATUS "Run time compiled kernels are not supported on this platform, disabling them")
+  set(XCFUN_ENABLE_JIT OFF CACHE BOOL "Allow compiling kernels for functional mixtures at run time" FORCE)
+endif()
+
+# Selective build, see src/functionals/CMakeLists.txt
+option_with_default(XCFUN_FUNCTIONALS "Functionals to compile, all if empty" "")
+foreach(_family LDA GGA MGGA)
+  option_with_default(XCFUN_${_family}_MIN_ORDER "Lowest kernel order compiled for ${_family} functionals" 0)
+  option_with_default(XCFUN_${_family}_MAX_ORDER "Highest kernel order compiled for ${_family} functionals" ${XCFUN_MAX_ORDER})
+  if(XCFUN_${_family}_MAX_ORDER GREATER XCFUN_MAX_ORDER OR
+     XCFUN_${_family}_MIN_ORDER GREATER XCFUN_${_family}_MAX_ORDER)
+    message(FATAL_ERROR "Invalid kernel order range for ${_family} functionals")
+  endif()
+endforeach()
+
 set(PROJECT_VERSION 2.1.1)
 set(PROJECT_VERSION_MAJOR 2)
 set(PROJECT_VERSION_MINOR 1)
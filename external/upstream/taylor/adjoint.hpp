@@ -0,0 +1,367 @@
+#pragma once
+
+/*
+  Reverse mode first derivatives. An adjoint<T> is a value together with
+  the index of the operation that produced it on an adjoint_tape. The
+  tape keeps, for each operation, the indices of its (at most two)
+  arguments and the partial derivatives with respect to them, evaluated
+  on the way forward. One backward sweep over the tape then gives the
+  derivatives of a result with respect to all variables, at a cost of a
+  few times that of the evaluation itself and independent of the number
+  of variables. Nothing is replayed, so the operations need no storage
+  beyond their local partials.
+
+  Entry 0 of the tape stands for all constants. Unused arguments point to
+  it, so that the sweep has no branches; its adjoint is never read.
+  Numbers not connected to a tape are constants.
+
+  With T = ctaylor<S,1> the values carry a directional derivative, and so
+  do the partials and the adjoints of the sweep (forward over reverse).
+  The adjoints of the variables then hold the gradient and, in the VAR0
+  coefficient, the Hessian times the direction.
+*/
+
+#include <vector>
+
+#include "ctaylor.hpp"
+#include "tmath.hpp"
+
+template <class T> struct adjoint_tape;
+
+template <class T> struct adjoint {
+  T value;
+  int index;
+  adjoint_tape<T> * tape;
+
+  adjoint() : value(0), index(0), tape(nullptr) {}
+  adjoint(const T & x) : value(x), index(0), tape(nullptr) {}
+  template <class S> adjoint(const S & x) : value(x), index(0), tape(nullptr) {}
+  adjoint(const T & x, int i, adjoint_tape<T> * t) : value(x), index(i), tape(t) {}
+  template <class S> adjoint<T> & operator=(const S & x) {
+    value = x;
+    index = 0;
+    tape = nullptr;
+    return *this;
+  }
+  adjoint<T> operator-() const;
+  template <class S> void operator+=(const S & x) { *this = *this + x; }
+  template <class S> void operator-=(const S & x) { *this = *this - x; }
+  template <class S> void operator*=(const S & x) { *this = *this * x; }
+  template <class S> void operator/=(const S & x) { *this = *this / x; }
+};
+
+template <class T> struct adjoint_tape {
+  struct node {
+    int arg[2];
+    T partial[2];
+  };
+  std::vector<node> nodes;
+
+  adjoint_tape() { clear(); }
+  void clear() {
+    nodes.resize(1);
+    nodes[0].arg[0] = nodes[0].arg[1] = 0;
+    nodes[0].partial[0] = nodes[0].partial[1] = 0;
+  }
+  int push(int a, const T & da, int b, const T & db) {
+    node n;
+    n.arg[0] = a;
+    n.arg[1] = b;
+    n.partial[0] = da;
+    n.partial[1] = db;
+    nodes.push_back(n);
+    return static_cast<int>(nodes.size()) - 1;
+  }
+  // A new independent variable
+  adjoint<T> variable(const T & x) { return adjoint<T>(x, push(0, 0, 0, 0), this); }
+  // Backward sweep from the result y. adj[] must have room for
+  // nodes.size() entries, on return adj[x.index] is dy/dx for each
+  // variable x.
+  void gradient(T adj[], const adjoint<T> & y) const {
+    for (size_t i = 0; i < nodes.size(); i++)
+      adj[i] = 0;
+    adj[y.index] = 1;
+    for (size_t i = nodes.size() - 1; i > 0; i--) {
+      const node & n = nodes[i];
+      T a = adj[i];
+      adj[n.arg[0]] += n.partial[0] * a;
+      adj[n.arg[1]] += n.partial[1] * a;
+    }
+  }
+};
+
+// f(x) with df/dx
+template <class T>
+static adjoint<T> adjoint_unary(const adjoint<T> & x, const T & f, const T & dx) {
+  if (!x.tape)
+    return adjoint<T>(f);
+  return adjoint<T>(f, x.tape->push(x.index, dx, 0, 0), x.tape);
+}
+
+// f(x,y) with df/dx and df/dy
+template <class T>
+static adjoint<T> adjoint_binary(const adjoint<T> & x,
+                                 const adjoint<T> & y,
+                                 const T & f,
+                                 const T & dx,
+                                 const T & dy) {
+  adjoint_tape<T> * tape = x.tape ? x.tape : y.tape;
+  if (!tape)
+    return adjoint<T>(f);
+  return adjoint<T>(f, tape->push(x.index, dx, y.index, dy), tape);
+}
+
+// f(x) for x = x0 + e*x1, from the Taylor coefficients t[] of f at x0:
+// f(x) = t0 + e*t1*x1 and f'(x) = t1 + e*2*t2*x1
+template <class T>
+static adjoint<ctaylor<T, 1>> adjoint_tangent(const adjoint<ctaylor<T, 1>> & x,
+                                              const T t[3]) {
+  ctaylor<T, 1> f, df;
+  f.c[0] = t[0];
+  f.c[1] = t[1] * x.value.c[1];
+  df.c[0] = t[1];
+  df.c[1] = 2 * t[2] * x.value.c[1];
+  return adjoint_unary(x, f, df);
+}
+
+// The value to compare, without derivatives
+template <class T> static const T & adjoint_primal(const T & x) { return x; }
+
+template <class T, int Nvar>
+static const T & adjoint_primal(const ctaylor<T, Nvar> & x) {
+  return x.c[0];
+}
+
+template <class T> adjoint<T> adjoint<T>::operator-() const {
+  return adjoint_unary(*this, -value, T(-1));
+}
+
+template <class T>
+static adjoint<T> operator+(const adjoint<T> & x, const adjoint<T> & y) {
+  return adjoint_binary(x, y, x.value + y.value, T(1), T(1));
+}
+
+template <class T, class S>
+static adjoint<T> operator+(const adjoint<T> & x, const S & y) {
+  return adjoint_unary(x, x.value + y, T(1));
+}
+
+template <class T, class S>
+static adjoint<T> operator+(const S & x, const adjoint<T> & y) {
+  return adjoint_unary(y, x + y.value, T(1));
+}
+
+template <class T>
+static adjoint<T> operator-(const adjoint<T> & x, const adjoint<T> & y) {
+  return adjoint_binary(x, y, x.value - y.value, T(1), T(-1));
+}
+
+template <class T, class S>
+static adjoint<T> operator-(const adjoint<T> & x, const S & y) {
+  return adjoint_unary(x, x.value - y, T(1));
+}
+
+template <class T, class S>
+static adjoint<T> operator-(const S & x, const adjoint<T> & y) {
+  return adjoint_unary(y, x - y.value, T(-1));
+}
+
+template <class T>
+static adjoint<T> operator*(const adjoint<T> & x, const adjoint<T> & y) {
+  return adjoint_binary(x, y, x.value * y.value, y.value, x.value);
+}
+
+template <class T, class S>
+static adjoint<T> operator*(const adjoint<T> & x, const S & y) {
+  return adjoint_unary(x, x.value * y, T(y));
+}
+
+template <class T, class S>
+static adjoint<T> operator*(const S & x, const adjoint<T> & y) {
+  return adjoint_unary(y, x * y.value, T(x));
+}
+
+template <class T>
+static adjoint<T> operator/(const adjoint<T> & x, const adjoint<T> & y) {
+  T inv = 1 / y.value;
+  T f = x.value * inv;
+  return adjoint_binary(x, y, f, inv, -f * inv);
+}
+
+template <class T, class S>
+static adjoint<T> operator/(const adjoint<T> & x, const S & y) {
+  T inv = 1 / T(y);
+  return adjoint_unary(x, x.value * inv, inv);
+}
+
+template <class T, class S>
+static adjoint<T> operator/(const S & x, const adjoint<T> & y) {
+  T inv = 1 / y.value;
+  T f = x * inv;
+  return adjoint_unary(y, f, -f * inv);
+}
+
+// Comparisons are on the values, as for ctaylor
+#define ADJOINT_COMPARE(OP)                                                         \
+  template <class T>                                                                \
+  static bool operator OP(const adjoint<T> & x, const adjoint<T> & y) {             \
+    return adjoint_primal(x.value) OP adjoint_primal(y.value);                      \
+  }                                                                                 \
+  template <class T, class S>                                                       \
+  static bool operator OP(const adjoint<T> & x, const S & y) {                      \
+    return adjoint_primal(x.value) OP y;                                            \
+  }                                                                                 \
+  template <class T, class S>                                                       \
+  static bool operator OP(const S & x, const adjoint<T> & y) {                      \
+    return x OP adjoint_primal(y.value);                                            \
+  }
+ADJOINT_COMPARE(<)
+ADJOINT_COMPARE(>)
+ADJOINT_COMPARE(<=)
+ADJOINT_COMPARE(>=)
+ADJOINT_COMPARE(==)
+ADJOINT_COMPARE(!=)
+#undef ADJOINT_COMPARE
+
+// The functions take value and derivative from the same expansions as
+// ctaylor, truncated at first order, or second with a direction
+#define ADJOINT_FUNCTION(F)                                                         \
+  template <class T> static adjoint<T> F(const adjoint<T> & x) {                    \
+    T tmp[2];                                                                       \
+    F##_expand<T, 1>(tmp, x.value);                                                 \
+    return adjoint_unary(x, tmp[0], tmp[1]);                                        \
+  }                                                                                 \
+  template <class T>                                                                \
+  static adjoint<ctaylor<T, 1>> F(const adjoint<ctaylor<T, 1>> & x) {               \
+    T tmp[3];                                                                       \
+    F##_expand<T, 2>(tmp, x.value.c[0]);                                            \
+    return adjoint_tangent(x, tmp);                                                 \
+  }
+ADJOINT_FUNCTION(exp)
+ADJOINT_FUNCTION(log)
+ADJOINT_FUNCTION(sqrt)
+ADJOINT_FUNCTION(cbrt)
+ADJOINT_FUNCTION(atan)
+ADJOINT_FUNCTION(erf)
+ADJOINT_FUNCTION(sin)
+ADJOINT_FUNCTION(cos)
+ADJOINT_FUNCTION(asin)
+ADJOINT_FUNCTION(acos)
+ADJOINT_FUNCTION(asinh)
+#undef ADJOINT_FUNCTION
+
+// exp(x)-1, but accurate for small x
+template <class T> static adjoint<T> expm1(const adjoint<T> & x) {
+  T tmp[2];
+  exp_expand<T, 1>(tmp, x.value);
+  return adjoint_unary(x, 2 * exp(x.value / 2) * sinh(x.value / 2), tmp[1]);
+}
+
+template <class T>
+static adjoint<ctaylor<T, 1>> expm1(const adjoint<ctaylor<T, 1>> & x) {
+  T tmp[3];
+  exp_expand<T, 2>(tmp, x.value.c[0]);
+  tmp[0] = 2 * exp(x.value.c[0] / 2) * sinh(x.value.c[0] / 2);
+  return adjoint_tangent(x, tmp);
+}
+
+// Through ctaylor, which switches to a Pade approximation near 0
+template <class T> static adjoint<T> sqrtx_asinh_sqrtx(const adjoint<T> & x) {
+  ctaylor<T, 1> t(x.value);
+  t.set(VAR0, 1);
+  t = sqrtx_asinh_sqrtx(t);
+  return adjoint_unary(x, t.c[0], t.c[VAR0]);
+}
+
+template <class T>
+static adjoint<ctaylor<T, 1>> sqrtx_asinh_sqrtx(const adjoint<ctaylor<T, 1>> & x) {
+  ctaylor<T, 2> t(x.value.c[0]);
+  t.set(VAR0, 1);
+  t.set(VAR1, 1);
+  t = sqrtx_asinh_sqrtx(t);
+  T tmp[3] = {t.c[0], t.c[VAR0], t.c[VAR0 | VAR1] / 2};
+  return adjoint_tangent(x, tmp);
+}
+
+template <class T> static adjoint<T> pow(const adjoint<T> & x, const double & a) {
+  T tmp[2];
+  pow_expand<T, 1>(tmp, x.value, a);
+  return adjoint_unary(x, tmp[0], tmp[1]);
+}
+
+template <class T>
+static adjoint<ctaylor<T, 1>> pow(const adjoint<ctaylor<T, 1>> & x,
+                                  const double & a) {
+  T tmp[3];
+  pow_expand<T, 2>(tmp, x.value.c[0], a);
+  return adjoint_tangent(x, tmp);
+}
+
+// Integer exponent version is analytical at x = 0, see ctaylor
+template <class T> static adjoint<T> pow(const adjoint<T> & x, int n) {
+  if (n > 0) {
+    T p = 1;
+    for (int i = 1; i < n; i++)
+      p *= x.value;
+    return adjoint_unary(x, p * x.value, n * p);
+  } else if (n < 0) {
+    return pow(x, double(n));
+  } else {
+    return adjoint<T>(1);
+  }
+}
+
+template <class T> static adjoint<T> abs(const adjoint<T> & x) {
+  if (adjoint_primal(x.value) < 0)
+    return -x;
+  else
+    return x;
+}
+
+template <class T>
+static adjoint<T> min(const adjoint<T> & a, const adjoint<T> & b) {
+  if (a <= b)
+    return a;
+  else
+    return b;
+}
+
+template <class T>
+static adjoint<T> max(const adjoint<T> & a, const adjoint<T> & b) {
+  if (a > b)
+    return a;
+  else
+    return b;
+}
+
+// Powers x^(k/3) of one argument, see tpow_thirds
+template <class T> struct adjoint_thirds {
+  adjoint<T> x;
+  tpow_thirds<T> base;
+
+  adjoint_thirds() = default;
+  explicit adjoint_thirds(const adjoint<T> & t) : x(t), base(t.value) {}
+  adjoint<T> operator()(int k) const {
+    T tmp[2];
+    base.template expand<1>(tmp, k);
+    return adjoint_unary(x, tmp[0], tmp[1]);
+  }
+};
+
+template <class T> struct adjoint_thirds<ctaylor<T, 1>> {
+  adjoint<ctaylor<T, 1>> x;
+  tpow_thirds<T> base;
+
+  adjoint_thirds() = default;
+  explicit adjoint_thirds(const adjoint<ctaylor<T, 1>> & t)
+      : x(t), base(t.value.c[0]) {}
+  adjoint<ctaylor<T, 1>> operator()(int k) const {
+    T tmp[3];
+    base.template expand<2>(tmp, k);
+    return adjoint_tangent(x, tmp);
+  }
+};
+
+template <class T> static adjoint_thirds<T> pow_thirds(const adjoint<T> & t) {
+  return adjoint_thirds<T>(t);
+}
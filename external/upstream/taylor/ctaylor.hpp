@@ -473,29 +473,15 @@ static ctaylor<T, Nvar> operator+(const ctaylor<T, Nvar> & t1,
   return tmp;
 }
 
-template <class T, int Nvar>
-static ctaylor<T, Nvar> operator-(const T & x, const ctaylor<T, Nvar> & t) {
-  ctaylor<T, Nvar> tmp = -t;
-  tmp.c[0] += x;
-  return tmp;
-}
-
-template <class T, int Nvar>
-static ctaylor<T, Nvar> operator-(const ctaylor<T, Nvar> & t, const T & x) {
-  ctaylor<T, Nvar> tmp = t;
-  tmp.c[0] -= x;
-  return tmp;
-}
-
-template <class T, int Nvar>
-static ctaylor<T, Nvar> operator-(int x, const ctaylor<T, Nvar> & t) {
+template <class T, int Nvar, class S>
+static ctaylor<T, Nvar> operator-(const S & x, const ctaylor<T, Nvar> & t) {
   ctaylor<T, Nvar> tmp = -t;
   tmp.c[0] += x;
   return tmp;
 }
 
-template <class T, int Nvar>
-static ctaylor<T, Nvar> operator-(const ctaylor<T, Nvar> & t, int x) {
+template <class T, int Nvar, class S>
+static ctaylor<T, Nvar> operator-(const ctaylor<T, Nvar> & t, const S & x) {
   ctaylor<T, Nvar> tmp = t;
   tmp.c[0] -= x;
   return tmp;
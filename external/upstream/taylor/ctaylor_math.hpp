@@ -71,7 +71,7 @@ template <class T, int Nvar>
 static ctaylor<T, Nvar> exp(const ctaylor<T, Nvar> & t) {
 #ifdef CTAYLOR_SPARSE
   if (t.isscalar)
-    return ctaylor<T, Nvar>(exp(t.c[0]));
+    return ctaylor<T, Nvar>(tmath_exp(t.c[0]));
 #endif
   T tmp[Nvar + 1];
   exp_expand<T, Nvar>(tmp, t.c[0]);
@@ -105,7 +105,7 @@ template <class T, int Nvar>
 static ctaylor<T, Nvar> log(const ctaylor<T, Nvar> & t) {
 #ifdef CTAYLOR_SPARSE
   if (t.isscalar)
-    return ctaylor<T, Nvar>(log(t.c[0]));
+    return ctaylor<T, Nvar>(tmath_log(t.c[0]));
 #endif
   T tmp[Nvar + 1];
   log_expand<T, Nvar>(tmp, t.c[0]);
@@ -120,7 +120,7 @@ template <class T, int Nvar>
 static ctaylor<T, Nvar> pow(const ctaylor<T, Nvar> & t, const double & a) {
 #ifdef CTAYLOR_SPARSE
   if (t.isscalar)
-    return ctaylor<T, Nvar>(pow(t.c[0], a));
+    return ctaylor<T, Nvar>(tmath_pow(t.c[0], a));
 #endif
   T tmp[Nvar + 1];
   pow_expand<T, Nvar>(tmp, t.c[0], a);
@@ -158,6 +158,32 @@ static ctaylor<T, Nvar> cbrt(const ctaylor<T, Nvar> & t) {
   return res;
 }
 
+// Powers t^(k/3) of one argument, sharing the cbrt and reciprocal of its
+// constant part. Each power is still a separate composition.
+template <class T, int Nvar> struct ctaylor_thirds {
+  ctaylor<T, Nvar> x;
+  tpow_thirds<T> base;
+
+  ctaylor_thirds() = default;
+  explicit ctaylor_thirds(const ctaylor<T, Nvar> & t) : x(t), base(t.c[0]) {}
+  ctaylor<T, Nvar> operator()(int k) const {
+#ifdef CTAYLOR_SPARSE
+    if (x.isscalar)
+      return ctaylor<T, Nvar>(base(k));
+#endif
+    T tmp[Nvar + 1];
+    base.template expand<Nvar>(tmp, k);
+    ctaylor<T, Nvar> res;
+    ctaylor_rec<T, Nvar>::compose(res.c, x.c, tmp);
+    return res;
+  }
+};
+
+template <class T, int Nvar>
+static ctaylor_thirds<T, Nvar> pow_thirds(const ctaylor<T, Nvar> & t) {
+  return ctaylor_thirds<T, Nvar>(t);
+}
+
 // Integer exponent version is analytical at t[0] = 0
 // This function gets priority over the normal pow
 // when the exponent is an integer, but does not force
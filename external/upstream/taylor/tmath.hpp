@@ -9,6 +9,7 @@
   pow
   sqrt
   cbrt (cube root)
+  rational powers in thirds of one base (pow_thirds)
   atan
   gauss (exp(-x^2))
   erf
@@ -30,6 +31,58 @@
 #include "micromath.hpp"
 #endif
 
+#ifdef TAYLOR_VMATH
+#include "vmath.hpp"
+#endif
+
+// The scalar seeds of exp, log, pow, atan and asinh. With TAYLOR_VMATH
+// double and float take the branch free versions in vmath.hpp, other types
+// use whatever overload argument dependent lookup finds.
+template <class T> static T tmath_exp(const T & x) {
+  using std::exp;
+  return exp(x);
+}
+
+template <class T> static T tmath_log(const T & x) {
+  using std::log;
+  return log(x);
+}
+
+template <class T, class S> static T tmath_pow(const T & x, const S & a) {
+  using std::pow;
+  return pow(x, a);
+}
+
+template <class T> static T tmath_atan(const T & x) {
+  using std::atan;
+  return atan(x);
+}
+
+template <class T> static T tmath_asinh(const T & x) {
+  using std::asinh;
+  return asinh(x);
+}
+
+#ifdef TAYLOR_VMATH
+static inline double tmath_exp(const double & x) { return vmath::exp(x); }
+static inline float tmath_exp(const float & x) { return vmath::exp(x); }
+static inline double tmath_log(const double & x) { return vmath::log(x); }
+static inline float tmath_log(const float & x) { return vmath::log(x); }
+static inline double tmath_pow(const double & x, const double & a) {
+  return vmath::pow(x, a);
+}
+static inline float tmath_pow(const float & x, const double & a) {
+  return static_cast<float>(vmath::pow(double(x), a));
+}
+static inline float tmath_pow(const float & x, const float & a) {
+  return vmath::pow(x, a);
+}
+static inline double tmath_atan(const double & x) { return vmath::atan(x); }
+static inline float tmath_atan(const float & x) { return vmath::atan(x); }
+static inline double tmath_asinh(const double & x) { return vmath::asinh(x); }
+static inline float tmath_asinh(const float & x) { return vmath::asinh(x); }
+#endif
+
 // Taylor math, template style
 // N is always the order of the polynomial
 
@@ -131,7 +184,7 @@ template <class T, int N> static void inv_expand(T * t, const T & a) {
 // Evaluate the taylor series of exp(x0+x)=exp(x0)*exp(x)
 template <class T, int Ndeg> static void exp_expand(T * t, const T & x0) {
   T ifac = 1;
-  t[0] = exp(x0);
+  t[0] = tmath_exp(x0);
   for (int i = 1; i <= Ndeg; i++) {
     ifac *= i;
     t[i] = t[0] / ifac;
@@ -141,7 +194,7 @@ template <class T, int Ndeg> static void exp_expand(T * t, const T & x0) {
 // Log series log(a+x) = log(1+x/a) + log(a)
 template <class T, int N> static void log_expand(T * t, const T & x0) {
   assert(x0 > 0 && "log(x) not real analytic at x <= 0");
-  t[0] = log(x0);
+  t[0] = tmath_log(x0);
   T x0inv = 1 / x0;
   T xn = x0inv;
   for (int i = 1; i <= N; i++) {
@@ -154,7 +207,7 @@ template <class T, int N> static void log_expand(T * t, const T & x0) {
 template <class T, int N> static void pow_expand(T * t, T x0, T a) {
   if (x0 <= 0)
     assert(x0 > 0 && "pow(x,a) not real analytic at x <= 0");
-  t[0] = pow(x0, a);
+  t[0] = tmath_pow(x0, a);
   T x0inv = 1 / x0;
   for (int i = 1; i <= N; i++)
     t[i] = t[i - 1] * x0inv * (a - i + 1) / i;
@@ -177,6 +230,46 @@ template <class T, int N> static void cbrt_expand(T * t, const T & x0) {
     t[i] = t[i - 1] * ((4 * x0inv) / (3 * i) - x0inv);
 }
 
+/* Powers x0^(k/3) of one base, which share a single cbrt and reciprocal.
+   Functionals use several of n^(-1/3), n^(4/3), n^(7/3) etc, which this
+   gives without a call to pow for each. Calling the object gives x0^(k/3),
+   expand() the Taylor series of (x0+x)^(k/3) like pow_expand. */
+template <class T> struct tpow_thirds {
+  T inv;     // 1/x0
+  T root[3]; // 1, x0^(1/3), x0^(2/3)
+  T x0;
+
+  tpow_thirds() = default;
+  explicit tpow_thirds(const T & x) : x0(x) {
+    inv = 1 / x;
+    root[0] = 1;
+    root[1] = cbrt(x);
+    root[2] = root[1] * root[1];
+  }
+  T operator()(int k) const {
+    int q = (k >= 0) ? k / 3 : -((2 - k) / 3); // Rounded down
+    T res = root[k - 3 * q];
+    for (; q > 0; q--)
+      res *= x0;
+    for (; q < 0; q++)
+      res *= inv;
+    return res;
+  }
+  template <int N> void expand(T * t, int k) const {
+    assert(x0 > 0 && "pow(x,a) not real analytic at x <= 0");
+    T a = k / T(3);
+    t[0] = (*this)(k);
+    for (int i = 1; i <= N; i++)
+      t[i] = t[i - 1] * inv * (a - i + 1) / i;
+  }
+};
+
+static inline tpow_thirds<double> pow_thirds(double x) {
+  return tpow_thirds<double>(x);
+}
+
+static inline tpow_thirds<float> pow_thirds(float x) { return tpow_thirds<float>(x); }
+
 // Use that d/dx atan(x) = 1/(1 + x^2),
 // Taylor expand in x^2 and integrate.
 template <class T, int Ndeg> static void atan_expand(T * t, T a) {
@@ -194,7 +287,7 @@ template <class T, int Ndeg> static void atan_expand(T * t, T a) {
   tfuns<T, Ndeg>::compose(t, x);
   // Integrate each term and set the constant
   tfuns<T, Ndeg>::integrate(t);
-  t[0] = atan(a);
+  t[0] = tmath_atan(a);
 }
 
 /*
@@ -270,7 +363,7 @@ template <class T, int Ndeg> static void asinh_expand(T * t, const T & a) {
   pow_expand<T, Ndeg>(t, tmp[0], -0.5);
   tfuns<T, Ndeg>::compose(t, tmp);
   tfuns<T, Ndeg>::integrate(t);
-  t[0] = asinh(a);
+  t[0] = tmath_asinh(a);
 }
 
 // arcsin function. d/dx asin(x) = 1/sqrt(1-x^2)
@@ -0,0 +1,219 @@
+#pragma once
+
+/*
+  Elementary functions for the scalar seeds of the Taylor expansions,
+  written without branches or table lookups so that loops over points
+  vectorize, and so that all platforms give the same results. GCC
+  if-converts the selects only with -fno-trapping-math, otherwise the
+  functions still run as straight scalar code.
+
+  Relative errors, measured against long double over millions of random
+  arguments in the ranges given:
+    exp(x)    x in [-708, 709]          below 1 ulp
+    log(x)    x in [1e-300, 1e300]      below 1 ulp
+    pow(x,a)  exp(a log(x))             below (1 + 2|a log(x)|) ulp
+    atan(x)   x in [-1e3, 1e3]          below 3 ulp
+    asinh(x)  x in [-1e3, 1e3]          below 3 ulp
+  Outside these ranges the results follow libm: exp underflows through
+  the subnormals to 0 and overflows to inf, log takes subnormals and
+  gives -inf at 0, inf at inf and NaN for negative numbers, pow(x, 0) is
+  1 and NaN propagates, but pow of a negative x is NaN also for integer
+  a. With -ffast-math, as in the Release flags of XCFun, the compiler
+  assumes that there are no infinities or NaN and flushes subnormals to
+  zero, and the reduction of exp loses up to 1e-13 of relative accuracy
+  near the ends of its range. float versions are evaluated in double and
+  rounded once.
+
+  erf stays with libm. It is only met in the range-separated exchange
+  functionals, and a branch free version would have to evaluate the
+  rational approximations of all its intervals at every call.
+*/
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace vmath {
+
+static inline double exp(double x) {
+  // exp(x) = 2^n exp(r), n = round(x/log(2)) and |r| <= log(2)/2
+  const double shifter = 6755399441055744.0; // 1.5*2^52
+  const double ln2_hi = 6.93147180369123816490e-01;
+  const double ln2_lo = 1.90821492927058770002e-10;
+  // Beyond these exp is 0 or inf
+  double lo = -746.0, hi = 710.0;
+  double xc = x < lo ? lo : x;
+  x = xc > hi ? hi : xc;
+  // Not (x/log(2) + shifter) - shifter, which -ffast-math folds to x/log(2).
+  // GCC expands rint inline, as one instruction from SSE4.1 on.
+  double n = std::rint(x * 1.44269504088896338700e+00);
+  // n is an integer below 2^52, so the sum is exact and n is in the low bits
+  double t = n + shifter;
+  std::int64_t ni;
+  std::memcpy(&ni, &t, sizeof(ni));
+  ni -= 0x4338000000000000LL; // The bits of shifter
+  double r = (x - n * ln2_hi) - n * ln2_lo;
+  // Taylor series to degree 13, the remainder is below 1e-17
+  double p = 1.0 / 6227020800.0;
+  p = p * r + 1.0 / 479001600.0;
+  p = p * r + 1.0 / 39916800.0;
+  p = p * r + 1.0 / 3628800.0;
+  p = p * r + 1.0 / 362880.0;
+  p = p * r + 1.0 / 40320.0;
+  p = p * r + 1.0 / 5040.0;
+  p = p * r + 1.0 / 720.0;
+  p = p * r + 1.0 / 120.0;
+  p = p * r + 1.0 / 24.0;
+  p = p * r + 1.0 / 6.0;
+  p = p * r + 0.5;
+  p = p * r * r + r;
+  // n added to the exponent bits of 1 + p, which is in [0.7, 1.5), gives
+  // the normal results without a multiplication that -ffast-math could
+  // reassociate into an overflow. Below 2^-1021 the result is built 2^54
+  // higher and scaled back, which rounds once to a subnormal or 0.
+  double m = 1.0 + p;
+  bool bottom = ni < -1021;
+  std::uint64_t bits;
+  std::memcpy(&bits, &m, sizeof(bits));
+  bits += static_cast<std::uint64_t>(bottom ? ni + 54 : ni) << 52;
+  double y;
+  std::memcpy(&y, &bits, sizeof(y));
+  y = bottom ? y * 5.5511151231257827e-17 : y;
+  y = x > 7.09782712893383973096e+02 ? HUGE_VAL : y; // log(DBL_MAX)
+  return x == x ? y : x;
+}
+
+static inline double log(double x) {
+  // x = 2^e m with m in [sqrt(1/2), sqrt(2)), log(m) = log(1+f)
+  const double ln2_hi = 6.93147180369123816490e-01;
+  const double ln2_lo = 1.90821492927058770002e-10;
+  // Subnormals are scaled by 2^54 into the normal numbers
+  bool subnormal = x < 2.2250738585072014e-308;
+  double xs = subnormal ? x * 18014398509481984.0 : x;
+  std::int64_t bits;
+  std::memcpy(&bits, &xs, sizeof(bits));
+  // The biased exponent as a double, without an integer conversion
+  std::int64_t e_bits = (bits >> 52) | 0x4330000000000000LL;
+  double e;
+  std::memcpy(&e, &e_bits, sizeof(e));
+  e -= 4503599627370496.0 + (subnormal ? 1077.0 : 1023.0); // 2^52 and the bias
+  bits = (bits & 0x000fffffffffffffLL) | 0x3ff0000000000000LL;
+  double m;
+  std::memcpy(&m, &bits, sizeof(m));
+  bool big = m > 1.41421356237309504880;
+  m = big ? 0.5 * m : m;
+  double k = big ? e + 1.0 : e;
+  double f = m - 1.0;
+  // log(1+f) = f - f^2/2 + s (f^2/2 + R(s^2)), s = f/(2+f), |s| < 0.172
+  double s = f / (2.0 + f);
+  double z = s * s;
+  double R = 2.0 / 21.0;
+  R = R * z + 2.0 / 19.0;
+  R = R * z + 2.0 / 17.0;
+  R = R * z + 2.0 / 15.0;
+  R = R * z + 2.0 / 13.0;
+  R = R * z + 2.0 / 11.0;
+  R = R * z + 2.0 / 9.0;
+  R = R * z + 2.0 / 7.0;
+  R = R * z + 2.0 / 5.0;
+  R = R * z + 2.0 / 3.0;
+  R *= z;
+  double hfsq = 0.5 * f * f;
+  double r = k * ln2_hi - ((hfsq - (s * (hfsq + R) + k * ln2_lo)) - f);
+  // log(0) = -inf, log(inf) = inf, and NaN below 0 and for NaN
+  double special = x == 0 ? -HUGE_VAL : (x > 0 ? x : std::numeric_limits<double>::quiet_NaN());
+  return (x > 0 && x < HUGE_VAL) ? r : special;
+}
+
+static inline double pow(double x, double a) {
+  double r = exp(a * log(x));
+  return a == 0 ? 1.0 : r;
+}
+
+static inline double atan(double x) {
+  // Reduced to t = |x| or 1/|x| in [0, 1], then to |u| <= tan(pi/12) with
+  // atan(t) = pi/6 + atan((sqrt(3) t - 1)/(t + sqrt(3)))
+  const double sqrt3 = 1.73205080756887729353;
+  const double pi_6 = 0.52359877559829887308;
+  const double pi_2 = 1.57079632679489661923;
+  double ax = std::fabs(x);
+  bool inverse = ax > 1.0;
+  double t = inverse ? 1.0 / ax : ax;
+  bool shift = t > 0.26794919243112270647;
+  double u = shift ? (sqrt3 * t - 1.0) / (t + sqrt3) : t;
+  // Taylor series to degree 33, the remainder is below 1e-20
+  double z = u * u;
+  double p = -1.0 / 33.0;
+  p = p * z + 1.0 / 31.0;
+  p = p * z - 1.0 / 29.0;
+  p = p * z + 1.0 / 27.0;
+  p = p * z - 1.0 / 25.0;
+  p = p * z + 1.0 / 23.0;
+  p = p * z - 1.0 / 21.0;
+  p = p * z + 1.0 / 19.0;
+  p = p * z - 1.0 / 17.0;
+  p = p * z + 1.0 / 15.0;
+  p = p * z - 1.0 / 13.0;
+  p = p * z + 1.0 / 11.0;
+  p = p * z - 1.0 / 9.0;
+  p = p * z + 1.0 / 7.0;
+  p = p * z - 1.0 / 5.0;
+  p = p * z + 1.0 / 3.0;
+  double r = u - u * z * p;
+  r = shift ? pi_6 + r : r;
+  r = inverse ? pi_2 - r : r;
+  return std::copysign(r, x);
+}
+
+static inline double asinh(double x) {
+  // Below 1/2 the Taylor series to degree 49, the remainder is below 1e-17.
+  // Above, log(|x| + sqrt(1 + x^2)) has no cancellation, and above 2^28
+  // it is log(2|x|) to double precision. Not the log1p form, which
+  // -ffast-math folds.
+  double ax = std::fabs(x);
+  double z = ax * ax;
+  double p = 0.002338091892111975;
+  p = p * z - 0.0024894486782468836;
+  p = p * z + 0.0026578706382072901;
+  p = p * z - 0.0028461784011089421;
+  p = p * z + 0.0030578216492580306;
+  p = p * z - 0.0032970595034734849;
+  p = p * z + 0.0035692053938259347;
+  p = p * z - 0.0038809645588376691;
+  p = p * z + 0.0042409070936793632;
+  p = p * z - 0.0046601434869150962;
+  p = p * z + 0.0051533096823199046;
+  p = p * z - 0.0057400376708419236;
+  p = p * z + 0.0064472103118896487;
+  p = p * z - 0.0073125258735988454;
+  p = p * z + 0.0083903358096168151;
+  p = p * z - 0.0097616095291940784;
+  p = p * z + 0.011551800896139705;
+  p = p * z - 0.013964843750000001;
+  p = p * z + 0.017352764423076924;
+  p = p * z - 0.022372159090909092;
+  p = p * z + 0.030381944444444444;
+  p = p * z - 0.044642857142857144;
+  p = p * z + 0.074999999999999997;
+  p = p * z - 0.16666666666666666;
+  double small = ax + ax * z * p;
+  bool big = ax > 268435456.0;
+  double a = big ? 1.0 : ax;
+  double large = big ? log(ax) + 6.93147180559945309417e-01 : log(a + std::sqrt(1.0 + a * a));
+  return std::copysign(ax < 0.5 ? small : large, x);
+}
+
+static inline float exp(float x) { return static_cast<float>(exp(double(x))); }
+
+static inline float log(float x) { return static_cast<float>(log(double(x))); }
+
+static inline float pow(float x, float a) {
+  return static_cast<float>(pow(double(x), double(a)));
+}
+
+static inline float atan(float x) { return static_cast<float>(atan(double(x))); }
+
+static inline float asinh(float x) { return static_cast<float>(asinh(double(x))); }
+
+} // namespace vmath
@@ -12,6 +12,11 @@
  * XCFun library, see: <https://xcfun.readthedocs.io/>
  */
 
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 
@@ -43,6 +48,8 @@ PYBIND11_MODULE(_xcfun, m) {
       .value("XC_A_B", xcfun_vars::XC_A_B)
       .value("XC_N_S", xcfun_vars::XC_N_S)
       .value("XC_A_GAA", xcfun_vars::XC_A_GAA)
+      .value("XC_N_GNN", xcfun_vars::XC_N_GNN)
+      .value("XC_A_B_GAA_GAB_GBB", xcfun_vars::XC_A_B_GAA_GAB_GBB)
       .value("XC_N_S_GNN_GNS_GSS", xcfun_vars::XC_N_S_GNN_GNS_GSS)
       .value("XC_A_GAA_LAPA", xcfun_vars::XC_A_GAA_LAPA)
       .value("XC_A_GAA_TAUA", xcfun_vars::XC_A_GAA_TAUA)
@@ -87,6 +94,10 @@ PYBIND11_MODULE(_xcfun, m) {
         &xcfun_splash,
         "XCFun splash screen",
         py::return_value_policy::copy);
+  m.def("xcfun_kernel_isa",
+        &xcfun_kernel_isa,
+        "Instruction set of the functional kernels in use",
+        py::return_value_policy::copy);
   m.def("xcfun_test", &xcfun_test, "XCFun testing");
 
   py::class_<XCFunctional>(m, "xc_functional");
@@ -108,6 +119,80 @@ PYBIND11_MODULE(_xcfun, m) {
         "fun"_a,
         "name"_a,
         "value"_a);
+  m.def("xcfun_set_lda_tables",
+        &xcfun::xcfun_set_lda_tables,
+        "Evaluate LDA functionals from interpolation tables",
+        "fun"_a,
+        "tolerance"_a);
+  m.def("xcfun_set_single_precision",
+        &xcfun::xcfun_set_single_precision,
+        "Evaluate the functional kernels in single precision",
+        "fun"_a,
+        "single"_a);
+  m.def("xcfun_set_spin_symmetry",
+        &xcfun::xcfun_set_spin_symmetry,
+        "Compute one of each alpha/beta pair of derivatives at closed-shell points",
+        "fun"_a,
+        "symmetric"_a);
+  m.def("xcfun_set_generated_kernels",
+        &xcfun::xcfun_set_generated_kernels,
+        "Use the kernels generated at build time for partial derivatives",
+        "fun"_a,
+        "generated"_a);
+  m.def("xcfun_uses_generated_kernels",
+        &xcfun::xcfun_uses_generated_kernels,
+        "Whether the current setup uses the generated kernels",
+        "fun"_a);
+  m.def("xcfun_set_jit",
+        &xcfun::xcfun_set_jit,
+        "Compile a kernel for the functional mixture at run time",
+        "fun"_a,
+        "jit"_a);
+  m.def("xcfun_uses_jit",
+        &xcfun::xcfun_uses_jit,
+        "Whether the current setup uses a kernel compiled at run time",
+        "fun"_a);
+  m.def("xcfun_get_profile",
+        [](const XCFunctional * fun, const char * name, xcfun_mode mode, int order) {
+          unsigned long long points, calls, cycles;
+          if (xcfun::xcfun_get_profile(
+                  fun, name, mode, order, &points, &calls, &cycles) != 0)
+            throw std::invalid_argument("No profile for " + std::string(name));
+          return py::make_tuple(points, calls, cycles);
+        },
+        "Points, kernel calls and cycles spent in one term of the functional",
+        "fun"_a,
+        "name"_a,
+        "mode"_a,
+        "order"_a);
+  m.def("xcfun_profile",
+        [](const XCFunctional * fun) {
+          py::dict profile;
+          unsigned long long points, calls, cycles;
+          for (int i = 0; i < fun->nr_active_functionals; i++) {
+            const char * name = xcfun_enumerate_parameters(fun->active_ids[i]);
+            for (int mode = XC_PARTIAL_DERIVATIVES; mode < XC_NR_MODES; mode++)
+              for (int order = 0; order <= XCFUN_MAX_ORDER; order++)
+                if (xcfun::xcfun_get_profile(fun,
+                                             name,
+                                             static_cast<xcfun_mode>(mode),
+                                             order,
+                                             &points,
+                                             &calls,
+                                             &cycles) == 0 &&
+                    points > 0)
+                  profile[py::make_tuple(
+                      name, static_cast<xcfun_mode>(mode), order)] =
+                      py::make_tuple(points, calls, cycles);
+          }
+          return profile;
+        },
+        "Nonzero profile counters of all terms, keyed by (name, mode, order)",
+        "fun"_a);
+  m.def("xcfun_reset_profile",
+        &xcfun::xcfun_reset_profile,
+        "Set all profile counters to zero",
+        "fun"_a);
   m.def("xcfun_is_gga",
         &xcfun::xcfun_is_gga,
         "Whether the functional is GGA",
@@ -129,6 +214,131 @@ PYBIND11_MODULE(_xcfun, m) {
         "vars"_a,
         "mode"_a,
         "order"_a);
+  m.def("xcfun_eval_planes",
+        [](const XCFunctional * fun,
+           py::array_t<double, py::array::c_style | py::array::forcecast> density) {
+          if (!fun->eval_ready || fun->mode != XC_PARTIAL_DERIVATIVES)
+            throw std::invalid_argument("Planes need a partial derivatives setup");
+          auto dens_len = xcfun::xcfun_input_length(fun);
+          if (density.ndim() != 2 || density.shape(1) != dens_len)
+            throw std::invalid_argument("Wrong dimension of density argument");
+          int nr_points = static_cast<int>(density.shape(0));
+          // One (components, points) array per order
+          py::list planes;
+          std::vector<double *> ptrs;
+          for (int k = 0, count = 1; k <= fun->order; k++) {
+            auto plane = py::array_t<double>({count, nr_points});
+            // Rows left out with the output mask are not written
+            if (!fun->output_mask.empty())
+              std::fill_n(plane.mutable_data(), plane.size(), 0.0);
+            ptrs.push_back(plane.mutable_data());
+            planes.append(plane);
+            count = count * (dens_len + k) / (k + 1);
+          }
+          xcfun::xcfun_eval_vec_planes(
+              fun, nr_points, density.data(), dens_len, ptrs.data(), nr_points);
+          return planes;
+        },
+        "Evaluate partial derivatives into one (components, points) array per order",
+        "fun"_a,
+        "density"_a);
+  m.def("xcfun_eval_kernel_contraction",
+        [](const XCFunctional * fun,
+           py::array_t<double, py::array::c_style | py::array::forcecast> density,
+           py::array_t<double, py::array::c_style | py::array::forcecast>
+               perturbed) {
+          if (!fun->eval_ready || fun->mode != XC_PARTIAL_DERIVATIVES ||
+              fun->order != 2)
+            throw std::invalid_argument(
+                "Contracted kernel needs a second order partial derivatives setup");
+          auto dens_len = xcfun::xcfun_input_length(fun);
+          // density is (points, vars) and perturbed (points, perturbations, vars)
+          if (density.ndim() != 2 || density.shape(1) != dens_len ||
+              perturbed.ndim() != 3 || perturbed.shape(0) != density.shape(0) ||
+              perturbed.shape(2) != dens_len)
+            throw std::invalid_argument(
+                "Wrong dimension of density or perturbed argument");
+          int nr_points = static_cast<int>(density.shape(0));
+          int nr_perturbations = static_cast<int>(perturbed.shape(1));
+          auto result = py::array_t<double>(
+              {perturbed.shape(0), perturbed.shape(1), perturbed.shape(2)});
+          xcfun::xcfun_eval_kernel_contraction(fun,
+                                               nr_points,
+                                               density.data(),
+                                               dens_len,
+                                               nr_perturbations,
+                                               perturbed.data(),
+                                               nr_perturbations * dens_len,
+                                               result.mutable_data(),
+                                               nr_perturbations * dens_len);
+          return result;
+        },
+        "Second derivatives contracted with perturbed densities",
+        "fun"_a,
+        "density"_a,
+        "perturbed"_a);
+  m.def("xcfun_eval_hessian_vector",
+        [](const XCFunctional * fun,
+           py::array_t<double, py::array::c_style | py::array::forcecast> density,
+           py::array_t<double, py::array::c_style | py::array::forcecast>
+               direction) {
+          if (!fun->eval_ready || fun->mode != XC_PARTIAL_DERIVATIVES ||
+              fun->order != 2)
+            throw std::invalid_argument(
+                "Hessian-vector product needs a second order partial "
+                "derivatives setup");
+          auto dens_len = xcfun::xcfun_input_length(fun);
+          // density and direction are (points, vars)
+          if (density.ndim() != 2 || density.shape(1) != dens_len ||
+              direction.ndim() != 2 || direction.shape(0) != density.shape(0) ||
+              direction.shape(1) != dens_len)
+            throw std::invalid_argument(
+                "Wrong dimension of density or direction argument");
+          int nr_points = static_cast<int>(density.shape(0));
+          auto result = py::array_t<double>(
+              {density.shape(0), static_cast<py::ssize_t>(1 + 2 * dens_len)});
+          xcfun::xcfun_eval_hessian_vector(fun,
+                                           nr_points,
+                                           density.data(),
+                                           dens_len,
+                                           direction.data(),
+                                           dens_len,
+                                           result.mutable_data(),
+                                           1 + 2 * dens_len);
+          return result;
+        },
+        "Energy, gradient and second derivatives times a direction",
+        "fun"_a,
+        "density"_a,
+        "direction"_a);
+  m.def("xcfun_set_output_mask",
+        [](XCFunctional * fun, py::object mask) {
+          int err_code;
+          if (mask.is_none()) {
+            err_code = xcfun::xcfun_set_output_mask(fun, nullptr);
+          } else {
+            auto flags = py::array_t<int, py::array::c_style | py::array::forcecast>(
+                mask);
+            if (fun->eval_ready && fun->mode == XC_PARTIAL_DERIVATIVES &&
+                flags.size() != xcfun::xcfun_output_length(fun))
+              throw std::invalid_argument("Wrong dimension of mask argument");
+            err_code = xcfun::xcfun_set_output_mask(fun, flags.data());
+          }
+          if (err_code != 0)
+            throw std::invalid_argument(
+                "Output mask needs a partial derivatives setup");
+        },
+        "Select the partial derivatives to compute, all if mask is None",
+        "fun"_a,
+        "mask"_a);
+  m.def("xcfun_input_length",
+        &xcfun::xcfun_input_length,
+        "Number of input variables per point",
+        "fun"_a);
+  m.def("xcfun_output_length",
+        &xcfun::xcfun_output_length,
+        "Number of outputs per point",
+        "fun"_a);
   m.def("xcfun_eval",
         [](XCFunctional * fun,
            py::array_t<double, py::array::c_style | py::array::forcecast> density) {
@@ -162,5 +372,182 @@ PYBIND11_MODULE(_xcfun, m) {
         "Evaluate XC functional",
         "fun"_a,
         "density"_a);
+  m.def("xcfun_eval_into",
+        [](const XCFunctional * fun, py::array density, py::array out, int threads) {
+          // No conversions: the caller would not see a converted copy of out
+          if (!py::isinstance<py::array_t<double>>(density) ||
+              !py::isinstance<py::array_t<double>>(out))
+            throw std::invalid_argument("density and out must be float64 arrays");
+          if (!fun->eval_ready)
+            throw std::invalid_argument("No valid setup, call xcfun_eval_setup");
+          auto dens_len = xcfun::xcfun_input_length(fun);
+          if (fun->mode == XC_CONTRACTED)
+            dens_len <<= fun->order;
+          auto output_len = xcfun::xcfun_output_length(fun);
+          auto ndim = density.ndim();
+          if ((ndim != 1 && ndim != 2) || out.ndim() != ndim)
+            throw std::invalid_argument("Wrong shape of density or out argument");
+          if (density.shape(ndim - 1) != dens_len ||
+              out.shape(ndim - 1) != output_len ||
+              (ndim == 2 && out.shape(0) != density.shape(0)))
+            throw std::invalid_argument(
+                "Wrong dimension of density or out argument");
+          for (auto a : {&density, &out})
+            for (py::ssize_t i = 0; i < ndim; i++)
+              if (a->strides(i) % py::ssize_t(sizeof(double)) != 0)
+                throw std::invalid_argument("Unaligned strides in density or out");
+          // Strides in doubles
+          auto step = [](const py::array & a, py::ssize_t i) {
+            return static_cast<int>(a.strides(i) / py::ssize_t(sizeof(double)));
+          };
+          int nr_points = (ndim == 2) ? static_cast<int>(density.shape(0)) : 1;
+          int dens_pitch = (ndim == 2) ? step(density, 0) : 0;
+          int dens_stride = step(density, ndim - 1);
+          int out_pitch = (ndim == 2) ? step(out, 0) : 0;
+          int out_stride = step(out, ndim - 1);
+          auto dens = static_cast<const double *>(density.data());
+          auto res = static_cast<double *>(out.mutable_data());
+
+          py::gil_scoped_release release;
+          if (threads < 1)
+            threads = static_cast<int>(std::thread::hardware_concurrency());
+          if (threads > nr_points)
+            threads = nr_points;
+          if (threads <= 1) {
+            xcfun::xcfun_eval_vec_strided(fun,
+                                          nr_points,
+                                          dens,
+                                          dens_pitch,
+                                          dens_stride,
+                                          res,
+                                          out_pitch,
+                                          out_stride);
+          } else {
+            std::vector<std::thread> pool;
+            int chunk = (nr_points + threads - 1) / threads;
+            for (int start = 0; start < nr_points; start += chunk) {
+              int count = std::min(chunk, nr_points - start);
+              pool.emplace_back([=] {
+                xcfun::xcfun_eval_vec_strided(
+                    fun,
+                    count,
+                    dens + static_cast<std::ptrdiff_t>(start) * dens_pitch,
+                    dens_pitch,
+                    dens_stride,
+                    res + static_cast<std::ptrdiff_t>(start) * out_pitch,
+                    out_pitch,
+                    out_stride);
+              });
+            }
+            for (auto & t : pool)
+              t.join();
+          }
+        },
+        "Evaluate XC functional into a preallocated array, without copies and "
+        "without holding the GIL. threads < 1 uses all cores.",
+        "fun"_a,
+        "density"_a,
+        "out"_a,
+        "threads"_a = 1);
+  m.def("xcfun_eval_weighted",
+        [](const XCFunctional * fun,
+           py::array_t<double, py::array::c_style | py::array::forcecast> density,
+           py::array_t<double, py::array::c_style | py::array::forcecast> weights) {
+          if (!fun->eval_ready)
+            throw std::invalid_argument("No valid setup, call xcfun_eval_setup");
+          auto dens_len = xcfun::xcfun_input_length(fun);
+          if (fun->mode == XC_CONTRACTED)
+            dens_len <<= fun->order;
+          auto output_len = xcfun::xcfun_output_length(fun);
+          if (density.ndim() != 2 || density.shape(1) != dens_len ||
+              weights.ndim() != 1 || weights.shape(0) != density.shape(0))
+            throw std::invalid_argument("Wrong dimension of density or weights");
+          int nr_points = static_cast<int>(density.shape(0));
+          auto result =
+              py::array_t<double>({density.shape(0), py::ssize_t(output_len)});
+          // Outputs left out with the output mask are not written
+          if (!fun->output_mask.empty())
+            std::fill_n(result.mutable_data(), result.size(), 0.0);
+          xcfun::xcfun_eval_vec_weighted(fun,
+                                         nr_points,
+                                         density.data(),
+                                         dens_len,
+                                         weights.data(),
+                                         result.mutable_data(),
+                                         output_len);
+          return result;
+        },
+        "Evaluate XC functional with the outputs multiplied by the weights",
+        "fun"_a,
+        "density"_a,
+        "weights"_a);
+  m.def("xcfun_eval_integrate",
+        [](const XCFunctional * fun,
+           py::array_t<double, py::array::c_style | py::array::forcecast> density,
+           py::array_t<double, py::array::c_style | py::array::forcecast> weights,
+           int threads) {
+          if (!fun->eval_ready)
+            throw std::invalid_argument("No valid setup, call xcfun_eval_setup");
+          auto dens_len = xcfun::xcfun_input_length(fun);
+          if (fun->mode == XC_CONTRACTED)
+            dens_len <<= fun->order;
+          if (density.ndim() != 2 || density.shape(1) != dens_len ||
+              weights.ndim() != 1 || weights.shape(0) != density.shape(0))
+            throw std::invalid_argument("Wrong dimension of density or weights");
+          int nr_points = static_cast<int>(density.shape(0));
+          auto dens = density.data();
+          auto w = weights.data();
+          // Each thread sums whole blocks, the block sums are then added in
+          // order as in a single call
+          const int block = xcfun::XC_SUM_BLOCK;
+          int nr_blocks = (nr_points + block - 1) / block;
+          std::vector<double> energy(nr_blocks), electrons(nr_blocks);
+          std::vector<int> err(nr_blocks);
+          auto blocks = [&](int first, int last) {
+            for (int b = first; b < last; b++) {
+              int start = b * block;
+              int count = std::min(block, nr_points - start);
+              err[b] = xcfun::xcfun_eval_integrate(
+                  fun,
+                  count,
+                  dens + static_cast<std::ptrdiff_t>(start) * dens_len,
+                  dens_len,
+                  w + start,
+                  &energy[b],
+                  &electrons[b]);
+            }
+          };
+          {
+            py::gil_scoped_release release;
+            if (threads < 1)
+              threads = static_cast<int>(std::thread::hardware_concurrency());
+            if (threads > nr_blocks)
+              threads = nr_blocks;
+            if (threads <= 1) {
+              blocks(0, nr_blocks);
+            } else {
+              std::vector<std::thread> pool;
+              int chunk = (nr_blocks + threads - 1) / threads;
+              for (int first = 0; first < nr_blocks; first += chunk)
+                pool.emplace_back(blocks, first, std::min(first + chunk, nr_blocks));
+              for (auto & t : pool)
+                t.join();
+            }
+          }
+          xcfun::xcint_sum energy_sum, electron_sum;
+          for (int b = 0; b < nr_blocks; b++) {
+            if (err[b] != 0)
+              throw std::invalid_argument("Energy kernels not compiled");
+            energy_sum.add(energy[b]);
+            electron_sum.add(electrons[b]);
+          }
+          return py::make_tuple(energy_sum.value(), electron_sum.value());
+        },
+        "Weighted sums of the energy and the density, reproducible with any "
+        "number of threads. threads < 1 uses all cores.",
+        "fun"_a,
+        "density"_a,
+        "weights"_a,
+        "threads"_a = 1);
 }
 } // namespace xcfun
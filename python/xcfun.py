@@ -12,6 +12,8 @@
 # For information on the complete list of contributors to the
 # XCFun library, see: <https://xcfun.readthedocs.io/>
 
+from concurrent.futures import ThreadPoolExecutor
+
 import numpy
 
 from ._xcfun import *
@@ -37,6 +39,7 @@ class Functional(object):
             blyp_func = Functional({'BeckeX': 1.0, 'LYPC': 1.0})
         """
         self._func = xcfun_new()
+        self._setup = None
         for name, weight in funcdict.items():
             ret = xcfun_set(self._func, name, weight)
             if not ret == 0:
@@ -45,6 +48,101 @@ class Functional(object):
     def __del__(self):
         xcfun_delete(self._func)
 
+    def setup(self, vars, mode, order):
+        """
+        Set up the evaluation with eval() and eval_chunks(). Repeating
+        the current setup is free, so the eval_* methods may switch between
+        setups cheaply.
+
+        input:
+            vars: input variables, for example XC_N_NX_NY_NZ
+            mode: XC_PARTIAL_DERIVATIVES, XC_POTENTIAL or XC_CONTRACTED
+            order: derivative order
+        """
+        if self._setup != (vars, mode, order):
+            try:
+                xcfun_eval_setup(self._func, vars, mode, order)
+            except ValueError as e:
+                # The functional keeps its previous setup, and so do we
+                raise XCFunException(str(e))
+            self._setup = (vars, mode, order)
+            self.input_length = xcfun_input_length(self._func)
+            self.output_length = xcfun_output_length(self._func)
+
+    def eval(self, density, out=None, threads=1):
+        """
+        Evaluate with the current setup, see setup().
+
+        input:
+            density: float64 numpy.array[0:nr_of_points, 0:input_length],
+                or a single point. Strided views are not copied.
+            out: optional float64 numpy.array[0:nr_of_points, 0:output_length]
+                to write the result to, may also be a strided view
+            threads: number of threads, all cores if less than 1
+        output:
+            return value: out, or a new array if out is None
+        """
+        if self._setup is None:
+            raise XCFunException('Functional.eval called before setup')
+        density = numpy.asarray(density, dtype=numpy.float64)
+        if out is None:
+            out = numpy.empty(density.shape[:-1] + (self.output_length,))
+        xcfun_eval_into(self._func, density, out, threads)
+        return out
+
+    def eval_chunks(self, source, chunk_size=1 << 20, threads=1):
+        """
+        Evaluate a large set of points in chunks, with the current setup.
+        The next chunk is read in a background thread while the current one
+        is evaluated, so that reading from disk overlaps with the evaluation.
+
+        input:
+            source: a numpy.array[0:nr_of_points, 0:input_length], typically
+                a numpy.memmap of a saved grid, or an iterable of such arrays
+            chunk_size: number of points per chunk for array sources
+            threads: number of threads for each chunk
+        output:
+            generator of the results of the chunks, in order
+        """
+        if hasattr(source, 'shape'):
+            chunks = (source[start:start + chunk_size]
+                      for start in range(0, source.shape[0], chunk_size))
+        else:
+            chunks = iter(source)
+
+        def load():
+            # Copying forces the pages of a memory map to be read
+            chunk = next(chunks, None)
+            if chunk is None:
+                return None
+            return numpy.ascontiguousarray(chunk, dtype=numpy.float64)
+
+        with ThreadPoolExecutor(max_workers=1) as reader:
+            pending = reader.submit(load)
+            while True:
+                chunk = pending.result()
+                if chunk is None:
+                    break
+                pending = reader.submit(load)
+                yield self.eval(chunk, threads=threads)
+
+    def profile(self):
+        """
+        Evaluation counters, only collected by libraries compiled with
+        XCFUN_ENABLE_PROFILING.
+
+        output:
+            dictionary with keys (functional name, mode, order) and values
+            (points, kernel calls, cycles)
+        """
+        return xcfun_profile(self._func)
+
+    def reset_profile(self):
+        """
+        Set the evaluation counters to zero.
+        """
+        xcfun_reset_profile(self._func)
+
     @property
     def type(self):
         if xcfun_is_metagga(self._func):
@@ -80,7 +178,7 @@ class Functional(object):
             if (densgrad is None):
                 raise XCFunException('Density gradient required for GGA energy')
 
-            xcfun_eval_setup(self._func, XC_N_NX_NY_NZ, XC_PARTIAL_DERIVATIVES, 0)
+            self.setup(XC_N_NX_NY_NZ, XC_PARTIAL_DERIVATIVES, 0)
 
             if not (densgrad.shape == (nr_points, 3)):
                 raise XCFunException('Wrong shape of densgrad argument in eval_energy_n '
@@ -91,7 +189,7 @@ class Functional(object):
             dens[:, 1:4] = densgrad[:, 0:3]
 
         else:
-            xcfun_eval_setup(self._func, XC_N, XC_PARTIAL_DERIVATIVES, 0)
+            self.setup(XC_N, XC_PARTIAL_DERIVATIVES, 0)
 
             dens = density.reshape((density.size, 1))
 
@@ -128,7 +226,7 @@ class Functional(object):
             if (densgrad is None) or (denshess is None):
                 raise XCFunException('Density gradient and Hessian required for GGA potential')
 
-            xcfun_eval_setup(self._func, XC_N_2ND_TAYLOR, XC_POTENTIAL, 1)
+            self.setup(XC_N_2ND_TAYLOR, XC_POTENTIAL, 1)
 
             if not (densgrad.shape == (nr_points, 3)):
                 raise XCFunException('Wrong shape of densgrad argument in eval_potential_n '
@@ -144,7 +242,7 @@ class Functional(object):
             dens[:, 4:10] = denshess[:, 0:6]
 
         else:
-            xcfun_eval_setup(self._func, XC_N, XC_POTENTIAL, 1)
+            self.setup(XC_N, XC_POTENTIAL, 1)
 
             dens = density.reshape((density.size, 1))
 
@@ -182,7 +280,7 @@ class Functional(object):
             if (densgrad is None):
                 raise XCFunException('Density gradient required for GGA energy')
 
-            xcfun_eval_setup(self._func, XC_A_B_AX_AY_AZ_BX_BY_BZ, XC_PARTIAL_DERIVATIVES, 0)
+            self.setup(XC_A_B_AX_AY_AZ_BX_BY_BZ, XC_PARTIAL_DERIVATIVES, 0)
 
             if not (densgrad.shape == (nr_points, 3, 2)):
                 raise XCFunException('Wrong shape of densgrad argument in eval_energy_ab '
@@ -195,7 +293,7 @@ class Functional(object):
             dens[:, 5:8] = densgrad[:, 0:3, 1]
 
         else:
-            xcfun_eval_setup(self._func, XC_A_B, XC_PARTIAL_DERIVATIVES, 0)
+            self.setup(XC_A_B, XC_PARTIAL_DERIVATIVES, 0)
 
             dens = density
 
@@ -239,7 +337,7 @@ class Functional(object):
             if (densgrad is None) or (denshess is None):
                 raise XCFunException('Density gradient and Hessian required for GGA potential')
 
-            xcfun_eval_setup(self._func, XC_A_B_2ND_TAYLOR, XC_POTENTIAL, 1)
+            self.setup(XC_A_B_2ND_TAYLOR, XC_POTENTIAL, 1)
 
             if not (densgrad.shape == (nr_points, 3, 2)):
                 raise XCFunException('Wrong shape of densgrad argument in eval_potential_n '
@@ -258,7 +356,7 @@ class Functional(object):
             dens[:, 14:20] = denshess[:, 0:6, 1]
 
         else:
-            xcfun_eval_setup(self._func, XC_A_B, XC_POTENTIAL, 1)
+            self.setup(XC_A_B, XC_POTENTIAL, 1)
 
             dens = density
 
@@ -15,13 +15,21 @@
 #include "XCFunctional.hpp"
 #include "XCFun/xcfun.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <map>
 #include <sstream>
+#include <type_traits>
+#include <vector>
 
 #include "functionals/list_of_functionals.hpp"
+#include "ldatable.hpp"
 #include "version_info.hpp"
 #include "xcint.hpp"
 
@@ -33,6 +41,153 @@
 #define AS_CTYPE(Type, Obj) reinterpret_cast<const Type *>(Obj)
 #endif
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef XCFUN_ENABLE_PROFILING
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline unsigned long long xcint_cycles() { return __rdtsc(); }
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+static inline unsigned long long xcint_cycles() { return __rdtsc(); }
+#else
+#include <chrono>
+// Nanoseconds where there is no time stamp counter
+static inline unsigned long long xcint_cycles() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+#endif
+#endif
+
+// Counters of one functional, mode and order. Atomic, so that several
+// threads may evaluate the same functional object.
+struct xcint_profile_entry {
+  std::atomic<unsigned long long> points{0};
+  std::atomic<unsigned long long> calls{0};
+  std::atomic<unsigned long long> cycles{0};
+};
+
+struct xcint_profile {
+  xcint_profile_entry entries[XC_NR_FUNCTIONALS][XC_NR_MODES][XCFUN_MAX_ORDER + 1];
+
+  xcint_profile_entry & at(const XCFunctional * fun, int id) {
+    return entries[id][fun->mode][fun->order];
+  }
+};
+
+// True if the active functionals have all kernels xcint_eval uses for this
+// setup. Selective builds may leave some out.
+static bool xcint_kernels_available(const XCFunctional * fun,
+                                    xcfun_vars vars,
+                                    xcfun_mode mode,
+                                    int order) {
+  bool need[XCFUN_MAX_ORDER + 1] = {false};
+  if (mode == XC_PARTIAL_DERIVATIVES) {
+    switch (order) {
+      case 0:
+        need[0] = true;
+        break;
+      case 1:
+        need[2] = true;
+        need[1] = (xcint_vars[vars].len & 1);
+        break;
+      case 3:
+        need[3] = true;
+        need[2] = true;
+        break;
+      default:
+        need[order] = true;
+    }
+  } else if (mode == XC_POTENTIAL) {
+    need[1] = true;
+    need[2] = (fun->depends & XC_GRADIENT);
+  } else {
+    need[order] = true;
+  }
+  for (int i = 0; i < fun->nr_active_functionals; i++)
+    for (int n = 0; n <= XCFUN_MAX_ORDER; n++)
+      if (need[n] && !xcint_has_kernel(*fun->active_terms[i].kernels, n))
+        return false;
+  return true;
+}
+
+// Input variables exchanged with each other by swapping alpha and beta.
+// False for vars without this symmetry, such as the total and spin density.
+static bool xcint_spin_swap(xcfun_vars vars, int swap[]) {
+  static const int a_b[] = {1, 0, 4, 3, 2, 6, 5, 8, 7, 10, 9};
+  static const int a_b_ax[] = {1, 0, 5, 6, 7, 2, 3, 4, 9, 8};
+  const int * table;
+  switch (vars) {
+    case XC_A_B:
+    case XC_A_B_GAA_GAB_GBB:
+    case XC_A_B_GAA_GAB_GBB_LAPA_LAPB:
+    case XC_A_B_GAA_GAB_GBB_TAUA_TAUB:
+    case XC_A_B_GAA_GAB_GBB_LAPA_LAPB_TAUA_TAUB:
+    case XC_A_B_GAA_GAB_GBB_LAPA_LAPB_TAUA_TAUB_JPAA_JPBB:
+      table = a_b;
+      break;
+    case XC_A_B_AX_AY_AZ_BX_BY_BZ:
+    case XC_A_B_AX_AY_AZ_BX_BY_BZ_TAUA_TAUB:
+      table = a_b_ax;
+      break;
+    case XC_A_B_2ND_TAYLOR:
+      for (int i = 0; i < 20; i++)
+        swap[i] = (i + 10) % 20;
+      return true;
+    default:
+      return false;
+  }
+  for (int i = 0; i < xcint_vars[vars].len; i++)
+    swap[i] = table[i];
+  return true;
+}
+
+// Outputs to compute at points with equal alpha and beta inputs, and the
+// output each one mirrors. Of two mirrored outputs only one is computed,
+// the first one unless only the second was selected with the output mask.
+static void xcint_spin_setup(XCFunctional * fun) {
+  int swap[XC_MAX_INVARS];
+  fun->spin_swap.clear();
+  fun->spin_mirror.clear();
+  fun->spin_mask.clear();
+  if (!fun->spin_symmetry || !fun->eval_ready ||
+      fun->mode != XC_PARTIAL_DERIVATIVES || !xcint_spin_swap(fun->vars, swap))
+    return;
+  int inlen = xcint_vars[fun->vars].len;
+  // Derivative multi-indices in the order of the outputs
+  std::vector<std::vector<int>> index(1);
+  for (int i = 0; i < inlen && fun->order >= 1; i++)
+    index.push_back({i});
+  for (int i = 0; i < inlen && fun->order >= 2; i++)
+    for (int j = i; j < inlen; j++)
+      index.push_back({i, j});
+  for (int i = 0; i < inlen && fun->order >= 3; i++)
+    for (int j = i; j < inlen; j++)
+      for (int s = j; s < inlen; s++)
+        index.push_back({i, j, s});
+  std::map<std::vector<int>, int> position;
+  for (size_t k = 0; k < index.size(); k++)
+    position[index[k]] = k;
+  fun->spin_swap.assign(swap, swap + inlen);
+  for (auto & idx : index) {
+    for (auto & i : idx)
+      i = swap[i];
+    std::sort(idx.begin(), idx.end());
+    fun->spin_mirror.push_back(position[idx]);
+  }
+  auto wanted = [fun](int k) {
+    return fun->output_mask.empty() || fun->output_mask[k];
+  };
+  for (size_t k = 0; k < index.size(); k++) {
+    int m = fun->spin_mirror[k];
+    fun->spin_mask.push_back(wanted(k) && (int(k) <= m || !wanted(m)));
+  }
+}
+
 namespace xcfun {
 auto version_as_string() noexcept -> std::string {
   std::ostringstream stream;
@@ -71,37 +226,50 @@ const char * xcfun_authors() {
          "Michael Seth\n";
 }
 
+const char * xcfun_kernel_isa() {
+  xcint_assure_setup();
+  return xcint_isa_name();
+}
+
 int xcfun_test() {
   int nfail = 0, res;
   for (auto f = 0; f < XC_NR_FUNCTIONALS; ++f) {
-    const functional_data * fd = &xcint_funs[f];
+    const functional_test * ft = xcint_tests[f];
+    if (!xcint_is_compiled(*xcint_funs[f]))
+      continue;
     auto fun = xcfun_new();
-    xcfun_set(fun, fd->name, 1.0);
+    xcfun_set(fun, xcint_names[f], 1.0);
 
-    if (fd->test_mode != XC_MODE_UNSET) {
+    if (ft->test_mode != XC_MODE_UNSET &&
+        !xcint_kernels_available(AS_CTYPE(XCFunctional, fun),
+                                 ft->test_vars,
+                                 ft->test_mode,
+                                 ft->test_order)) {
+      fprintf(stderr, "%s test kernels not compiled\n", xcint_names[f]);
+    } else if (ft->test_mode != XC_MODE_UNSET) {
       if ((res = xcfun_eval_setup(
-               fun, fd->test_vars, fd->test_mode, fd->test_order)) == 0) {
+               fun, ft->test_vars, ft->test_mode, ft->test_order)) == 0) {
         int n = xcfun_output_length(fun);
         auto out = new double[n];
-        if (fd->test_in.empty())
+        if (ft->test_in.empty())
           xcfun::die("Functional has no test input!", f);
-        xcfun_eval(fun, fd->test_in.data(), out);
+        xcfun_eval(fun, ft->test_in.data(), out);
         int nerr = 0;
         for (auto i = 0; i < n; ++i)
-          if (std::abs(out[i] - fd->test_out[i]) >
-              std::abs(fd->test_out[i] * fd->test_threshold))
+          if (std::abs(out[i] - ft->test_out[i]) >
+              std::abs(ft->test_out[i] * ft->test_threshold))
             nerr++;
         if (nerr > 0) {
           fprintf(stderr,
                   "Error detected in functional %s with tolerance %g:\n",
-                  fd->name,
-                  fd->test_threshold);
+                  xcint_names[f],
+                  ft->test_threshold);
           fprintf(stderr, "Abs.Error \tComputed              Reference\n");
           for (auto i = 0; i < n; ++i) {
-            fprintf(stderr, "%.1e", std::abs(out[i] - fd->test_out[i]));
-            fprintf(stderr, "    %+.16e \t%+.16e", out[i], fd->test_out[i]);
-            if (std::abs(out[i] - fd->test_out[i]) >
-                std::abs(fd->test_out[i] * fd->test_threshold))
+            fprintf(stderr, "%.1e", std::abs(out[i] - ft->test_out[i]));
+            fprintf(stderr, "    %+.16e \t%+.16e", out[i], ft->test_out[i]);
+            if (std::abs(out[i] - ft->test_out[i]) >
+                std::abs(ft->test_out[i] * ft->test_threshold))
               fprintf(stderr, " *");
             fprintf(stderr, "\n");
           }
@@ -111,12 +279,12 @@ int xcfun_test() {
       } else {
         fprintf(stderr,
                 "Functional %s not supporting its own test, error %i\n",
-                fd->name,
+                xcint_names[f],
                 res);
         nfail++;
       }
     } else {
-      fprintf(stderr, "%s has no test\n", fd->name);
+      fprintf(stderr, "%s has no test\n", xcint_names[f]);
     }
     xcfun_delete(fun);
   }
@@ -302,9 +470,9 @@ xcfun_mode xcfun_which_mode(const unsigned int mode_type) {
 const char * xcfun_enumerate_parameters(int param) {
   xcint_assure_setup();
   if (param >= 0 && param < XC_NR_FUNCTIONALS) {
-    return xcint_funs[param].name;
+    return xcint_names[param];
   } else if (param < XC_NR_PARAMETERS_AND_FUNCTIONALS) {
-    return xcint_params[param].name;
+    return xcint_names[param];
   } else {
     return 0;
   }
@@ -323,9 +491,9 @@ const char * xcfun_describe_short(const char * name) {
   xcint_assure_setup();
   int k;
   if ((k = xcint_lookup_functional(name)) >= 0) {
-    return xcint_funs[k].short_description;
+    return xcint_descriptions[k]->short_description;
   } else if ((k = xcint_lookup_parameter(name)) >= 0) {
-    return xcint_params[k].description;
+    return xcint_params[k]->description;
   } else if ((k = xcint_lookup_alias(name)) >= 0) {
     return xcint_aliases[k].description;
   } else {
@@ -337,9 +505,9 @@ const char * xcfun_describe_long(const char * name) {
   xcint_assure_setup();
   int k;
   if ((k = xcint_lookup_functional(name)) >= 0) {
-    return xcint_funs[k].long_description;
+    return xcint_descriptions[k]->long_description;
   } else if ((k = xcint_lookup_parameter(name)) >= 0) {
-    return xcint_params[k].description;
+    return xcint_params[k]->description;
   } else if ((k = xcint_lookup_alias(name)) >= 0) {
     return xcint_aliases[k].description;
   } else {
@@ -351,13 +519,17 @@ XCFunctional::XCFunctional() {
   for (int i = 0; i < XC_NR_FUNCTIONALS; ++i)
     settings[i] = 0;
   for (int i = XC_NR_FUNCTIONALS; i < XC_NR_PARAMETERS_AND_FUNCTIONALS; ++i)
-    settings[i] = xcint_params[i].default_value;
+    settings[i] = xcint_params[i]->default_value;
 }
 
 namespace xcfun {
 XCFunctional * xcfun_new() {
   xcint_assure_setup();
-  return new XCFunctional();
+  auto fun = new XCFunctional();
+#ifdef XCFUN_ENABLE_PROFILING
+  fun->profile = std::make_shared<xcint_profile>();
+#endif
+  return fun;
 }
 
 void xcfun_delete(XCFunctional * fun) {
@@ -370,23 +542,40 @@ int xcfun_set(XCFunctional * fun, const char * name, double value) {
   xcint_assure_setup();
   int item;
   if ((item = xcint_lookup_functional(name)) >= 0) {
+    if (!xcint_is_compiled(*xcint_funs[item]))
+      return -1;
     fun->settings[item] += value;
+    // The run time compiled kernel has the old weight as a constant
+    fun->jit = nullptr;
     // Do not extend list if functional is active
     bool found = false;
     for (int i = 0; i < fun->nr_active_functionals; i++)
-      if (fun->active_functionals[i] == &xcint_funs[item]) {
+      if (fun->active_ids[i] == item) {
+        fun->active_terms[i].weight = fun->settings[item];
         found = true;
         break;
       }
     if (!found) {
-      fun->active_functionals[fun->nr_active_functionals++] = &xcint_funs[item];
-      fun->depends |= xcint_funs[item].depends;
+      fun->active_ids[fun->nr_active_functionals] =
+          static_cast<xcfun_functional_id>(item);
+      fun->active_terms[fun->nr_active_functionals++] = {xcint_funs[item],
+                                                         fun->settings[item]};
+      fun->depends |= xcint_funs[item]->depends;
+      // The evaluation setup was checked without this functional
+      fun->eval_ready = false;
     }
     return 0;
   } else if ((item = xcint_lookup_parameter(name)) >= 0) {
     fun->settings[item] = value;
+    fun->jit = nullptr;
     return 0;
   } else if ((item = xcint_lookup_alias(name)) >= 0) {
+    // Set nothing if a term is not compiled in this build
+    for (int i = 0; i < MAX_ALIAS_TERMS && xcint_aliases[item].terms[i].name; i++) {
+      int f = xcint_lookup_functional(xcint_aliases[item].terms[i].name);
+      if (f >= 0 && !xcint_is_compiled(*xcint_funs[f]))
+        return -1;
+    }
     for (int i = 0; i < MAX_ALIAS_TERMS; i++) {
       if (!xcint_aliases[item].terms[i].name)
         break;
@@ -417,6 +606,108 @@ int xcfun_get(const XCFunctional * fun, const char * name, double * value) {
   return -1;
 }
 
+int xcfun_set_lda_tables(XCFunctional * fun, double tolerance) {
+  if (tolerance < 0)
+    return -1;
+  fun->lda_table_tolerance = tolerance;
+  return 0;
+}
+
+int xcfun_set_single_precision(XCFunctional * fun, bool single) {
+#ifdef XCFUN_ENABLE_SINGLE
+  fun->single_precision = single;
+  return 0;
+#else
+  (void)fun;
+  return single ? -1 : 0;
+#endif
+}
+
+int xcfun_set_spin_symmetry(XCFunctional * fun, bool symmetric) {
+  int swap[XC_MAX_INVARS];
+  if (symmetric && fun->eval_ready &&
+      (fun->mode != XC_PARTIAL_DERIVATIVES || !xcint_spin_swap(fun->vars, swap)))
+    return -1;
+  fun->spin_symmetry = symmetric;
+  xcint_spin_setup(fun);
+  return 0;
+}
+
+// The run time compiled kernel of the mixture, unless interpolation tables
+// are used
+static void xcint_jit_setup(XCFunctional * fun) {
+  fun->jit = nullptr;
+  if (!fun->jit_kernels || !fun->eval_ready)
+    return;
+  for (int i = 0; i < fun->nr_active_functionals; i++)
+    if (fun->lda_tables[i])
+      return;
+  fun->jit = xcint_jit_kernel(fun);
+}
+
+int xcfun_set_generated_kernels(XCFunctional * fun, bool generated) {
+#ifdef XCFUN_ENABLE_CODEGEN
+  fun->generated_kernels = generated;
+  return 0;
+#else
+  (void)fun;
+  return generated ? -1 : 0;
+#endif
+}
+
+int xcfun_set_jit(XCFunctional * fun, bool jit) {
+#ifdef XCFUN_ENABLE_JIT
+  fun->jit_kernels = jit;
+  xcint_jit_setup(fun);
+  return 0;
+#else
+  (void)fun;
+  return jit ? -1 : 0;
+#endif
+}
+
+bool xcfun_uses_jit(const XCFunctional * fun) { return fun->eval_ready && fun->jit; }
+
+bool xcfun_uses_generated_kernels(const XCFunctional * fun) {
+  if (!fun->generated_kernels || !fun->eval_ready)
+    return false;
+  for (int i = 0; i < fun->nr_active_functionals; i++)
+    if (!fun->generated[i] || fun->lda_tables[i])
+      return false;
+  return true;
+}
+
+int xcfun_get_profile(const XCFunctional * fun,
+                      const char * name,
+                      xcfun_mode mode,
+                      int order,
+                      unsigned long long * points,
+                      unsigned long long * calls,
+                      unsigned long long * cycles) {
+  xcint_assure_setup();
+  int item = xcint_lookup_functional(name);
+  if (!fun->profile || item < 0 || mode <= XC_MODE_UNSET || mode >= XC_NR_MODES ||
+      order < 0 || order > XCFUN_MAX_ORDER)
+    return -1;
+  const xcint_profile_entry & p = fun->profile->entries[item][mode][order];
+  *points = p.points.load(std::memory_order_relaxed);
+  *calls = p.calls.load(std::memory_order_relaxed);
+  *cycles = p.cycles.load(std::memory_order_relaxed);
+  return 0;
+}
+
+void xcfun_reset_profile(XCFunctional * fun) {
+  if (!fun->profile)
+    return;
+  for (auto & modes : fun->profile->entries)
+    for (auto & orders : modes)
+      for (auto & p : orders) {
+        p.points = 0;
+        p.calls = 0;
+        p.cycles = 0;
+      }
+}
+
 bool xcfun_is_gga(const XCFunctional * fun) { return (fun->depends & XC_GRADIENT); }
 
 bool xcfun_is_metagga(const XCFunctional * fun) {
@@ -427,12 +718,17 @@ int xcfun_eval_setup(XCFunctional * fun,
                      xcfun_vars vars,
                      xcfun_mode mode,
                      int order) {
+  if (vars <= XC_VARS_UNSET || vars >= XC_NR_VARS || !xcint_densvars_supported(vars))
+    return xcfun::XC_EVARS;
+  if (mode <= XC_MODE_UNSET || mode >= XC_NR_MODES)
+    return xcfun::XC_EMODE;
   // Check that vars are enough for the functional
   if ((fun->depends & xcint_vars[vars].provides) != fun->depends) {
     return xcfun::XC_EVARS;
   }
+  // Partial derivatives are implemented up to third order
   if ((order < 0 || order > XCFUN_MAX_ORDER) ||
-      (mode == XC_PARTIAL_DERIVATIVES && order > 4))
+      (mode == XC_PARTIAL_DERIVATIVES && order > 3))
     return xcfun::XC_EORDER;
   if (mode == XC_POTENTIAL) {
     // GGA potential needs full laplacian
@@ -445,9 +741,23 @@ int xcfun_eval_setup(XCFunctional * fun,
     if (fun->depends & (XC_LAPLACIAN | XC_KINETIC))
       return xcfun::XC_EMODE;
   }
+  if (!xcint_kernels_available(fun, vars, mode, order))
+    return xcfun::XC_EORDER;
   fun->mode = mode;
   fun->vars = vars;
   fun->order = order;
+  fun->eval_ready = true;
+  fun->output_mask.clear();
+  xcint_spin_setup(fun);
+  for (int i = 0; i < fun->nr_active_functionals; i++) {
+    fun->lda_tables[i] =
+        xcint_lda_table(fun->active_ids[i], fun->lda_table_tolerance);
+    fun->generated[i] =
+        mode == XC_PARTIAL_DERIVATIVES
+            ? xcint_generated_kernel(fun->active_ids[i], vars, order)
+            : nullptr;
+  }
+  xcint_jit_setup(fun);
   return 0;
 }
 
@@ -485,73 +795,274 @@ int xcfun_output_length(const XCFunctional * fun) {
     else
       return 3; // Spin-resolved potential
   } else {
-    xcfun::die("XC_CONTRACTED not implemented in xc_output_length()", 0);
-    return 0;
+    return 1 << fun->order;
   }
 }
 
-void xcfun_eval(const XCFunctional * fun, const double input[], double output[]) {
-  if (fun->mode == XC_MODE_UNSET)
-    xcfun::die("xc_eval() called before a mode was successfully set", 0);
-  if (fun->vars == XC_VARS_UNSET)
-    xcfun::die("xc_eval() called before variables were successfully set", 0);
-  if (fun->order == -1 && fun->mode != XC_POTENTIAL)
-    xcfun::die("xc_eval() called before the order was successfully set", 0);
+// Number of doubles read by xcfun_eval for one point
+static int xcint_eval_input_length(const XCFunctional * fun) {
+  int len = xcint_vars[fun->vars].len;
+  return fun->mode == XC_CONTRACTED ? len << fun->order : len;
+}
+
+// Kernel of order N, so that the evaluation code can be written once for
+// all ctaylor types.
+#define KERNEL(N, E)                                                                \
+  static inline ctaylor<ireal_t, N> xcint_kernel(                                   \
+      const functional_data * f, const densvars<ctaylor<ireal_t, N>> & d) {         \
+    return f->fp##N(d);                                                             \
+  }
+FOR_EACH(XCFUN_MAX_ORDER, KERNEL, )
+#ifdef XCFUN_ENABLE_SINGLE
+#define KERNELF(N, E)                                                               \
+  static inline ctaylor<float, N> xcint_kernel(                                     \
+      const functional_data * f, const densvars<ctaylor<float, N>> & d) {           \
+    return f->fpf##N(d);                                                            \
+  }
+FOR_EACH(XCFUN_MAX_ORDER, KERNELF, )
+#endif
+
+// Weighted sum of the active functionals. The sum is always taken in
+// ireal_t, also when the kernels are evaluated in single precision.
+template <typename K, int N>
+static ctaylor<ireal_t, N> xcint_eval_functionals(
+    const XCFunctional * fun,
+    const densvars<ctaylor<K, N>> & d) {
+  ctaylor<ireal_t, N> out = 0;
+  for (int i = 0; i < fun->nr_active_functionals; i++) {
+    const functional_data * f = fun->active_terms[i].kernels;
+    const lda_table * tab = fun->lda_tables[i].get();
+#ifdef XCFUN_ENABLE_PROFILING
+    unsigned long long start = fun->profile ? xcint_cycles() : 0;
+#endif
+    ctaylor<K, N> e = (tab && N >= tab->min_order && tab->covers(d))
+                          ? tab->eval(d)
+                          : xcint_kernel(f, d);
+#ifdef XCFUN_ENABLE_PROFILING
+    if (fun->profile) {
+      xcint_profile_entry & p = fun->profile->at(fun, fun->active_ids[i]);
+      p.calls.fetch_add(1, std::memory_order_relaxed);
+      p.cycles.fetch_add(xcint_cycles() - start, std::memory_order_relaxed);
+    }
+#endif
+    for (int j = 0; j < (1 << N); j++)
+      out.c[j] += fun->active_terms[i].weight * e.c[j];
+  }
+  return out;
+}
+
+// Outputs to compute, all if mask is null
+static inline bool xcint_wanted(const char * mask, int k) {
+  return !mask || mask[k];
+}
+
+// True if the point has equal alpha and beta inputs, see xcint_spin_setup()
+static bool xcint_spin_symmetric(const XCFunctional * fun, const double input[]) {
+  if (fun->spin_mask.empty())
+    return false;
+  for (size_t i = 0; i < fun->spin_swap.size(); i++)
+    if (input[i] != input[fun->spin_swap[i]])
+      return false;
+  return true;
+}
+
+// Scratch of one thread for the Taylor passes of order N, the inputs and
+// the density variables. It is reused by every pass, point and call, where
+// building these on the stack each time would clear and touch 22 kB at
+// order 6 in double precision.
+template <typename K, int N> struct xcint_workspace {
+  explicit xcint_workspace(const XCFunctional * fun) : vars(fun->vars), d(fun) {}
+  xcfun_vars vars;
+  ctaylor<K, N> in[XC_MAX_INVARS];
+  densvars<ctaylor<K, N>> d;
+};
+
+// The workspace of the calling thread, made anew when the vars change. The
+// density variables are then refilled with densvars::fill().
+template <typename K, int N>
+static xcint_workspace<K, N> & xcint_thread_workspace(const XCFunctional * fun) {
+  static thread_local std::unique_ptr<xcint_workspace<K, N>> w;
+  if (!w || w->vars != fun->vars)
+    w.reset(new xcint_workspace<K, N>(fun));
+  w->d.parent = fun;
+  return *w;
+}
+
+// Number of variables from which the reverse mode is used for first
+// derivatives. Below it the forward passes, two variables each, are faster.
+#define XCINT_ADJOINT_MIN_VARS 3
+
+// Energy and first derivatives in one forward and one backward sweep, see
+// adjoint.hpp. Returns false, without output, if an active functional has
+// no reverse mode kernel or uses an LDA table.
+static bool xcint_eval_adjoint(const XCFunctional * fun,
+                               const double input[],
+                               double output[],
+                               const char * mask) {
+  for (int i = 0; i < fun->nr_active_functionals; i++)
+    if (!fun->active_terms[i].kernels->fpa || fun->lda_tables[i])
+      return false;
+  // Kept between points, so that they are allocated only once per thread
+  static thread_local adjoint_tape<ireal_t> tape;
+  static thread_local std::vector<ireal_t> adj;
+  int inlen = xcint_vars[fun->vars].len;
+  adjoint<ireal_t> in[XC_MAX_INVARS];
+  tape.clear();
+  for (int i = 0; i < inlen; i++)
+    in[i] = tape.variable(input[i]);
+  densvars<adjoint<ireal_t>> d(fun, in);
+  adjoint<ireal_t> out = 0;
+  for (int i = 0; i < fun->nr_active_functionals; i++) {
+    const functional_data * f = fun->active_terms[i].kernels;
+#ifdef XCFUN_ENABLE_PROFILING
+    unsigned long long start = fun->profile ? xcint_cycles() : 0;
+#endif
+    adjoint<ireal_t> e = f->fpa(d);
+#ifdef XCFUN_ENABLE_PROFILING
+    if (fun->profile) {
+      xcint_profile_entry & p = fun->profile->at(fun, fun->active_ids[i]);
+      p.calls.fetch_add(1, std::memory_order_relaxed);
+      p.cycles.fetch_add(xcint_cycles() - start, std::memory_order_relaxed);
+    }
+#endif
+    out += fun->active_terms[i].weight * e;
+  }
+  adj.resize(tape.nodes.size());
+  tape.gradient(adj.data(), out);
+  if (xcint_wanted(mask, 0))
+    output[0] = out.value;
+  for (int i = 0; i < inlen; i++)
+    if (xcint_wanted(mask, i + 1))
+      output[i + 1] = adj[in[i].index];
+  return true;
+}
+
+// Partial derivatives from the run time compiled kernel of the mixture, or
+// from the straight-line kernels of tools/codegen if selected and every
+// active functional has one for the setup. Returns false, without output,
+// otherwise.
+static bool xcint_eval_generated(const XCFunctional * fun,
+                                 const double input[],
+                                 double output[],
+                                 const char * mask) {
+  double out[xcint_taylorlen(XCINT_GENERATED_MAX_INVARS, XCINT_GENERATED_MAX_ORDER)];
+  int len = taylorlen(xcint_vars[fun->vars].len, fun->order);
+  if (fun->jit) {
+    std::fill(out, out + len, 0.0);
+    fun->jit(1.0, input, out);
+    for (int k = 0; k < len; k++)
+      if (xcint_wanted(mask, k))
+        output[k] = out[k];
+    return true;
+  }
+  if (!fun->generated_kernels)
+    return false;
+  for (int i = 0; i < fun->nr_active_functionals; i++)
+    if (!fun->generated[i] || fun->lda_tables[i])
+      return false;
+  std::fill(out, out + len, 0.0);
+  for (int i = 0; i < fun->nr_active_functionals; i++) {
+#ifdef XCFUN_ENABLE_PROFILING
+    unsigned long long start = fun->profile ? xcint_cycles() : 0;
+#endif
+    fun->generated[i](fun->active_terms[i].weight, input, out);
+#ifdef XCFUN_ENABLE_PROFILING
+    if (fun->profile) {
+      xcint_profile_entry & p = fun->profile->at(fun, fun->active_ids[i]);
+      p.calls.fetch_add(1, std::memory_order_relaxed);
+      p.cycles.fetch_add(xcint_cycles() - start, std::memory_order_relaxed);
+    }
+#endif
+  }
+  for (int k = 0; k < len; k++)
+    if (xcint_wanted(mask, k))
+      output[k] = out[k];
+  return true;
+}
+
+// Evaluation with kernels of scalar type K, accumulated in ireal_t
+template <typename K>
+static void xcint_eval(const XCFunctional * fun,
+                       const double input[],
+                       double output[]) {
   if (fun->mode == XC_PARTIAL_DERIVATIVES) {
+    // Passes are skipped when none of their outputs is wanted. Every pass
+    // also gives the energy, and every pass of a row the first derivative.
+    const char * mask = fun->output_mask.empty() ? nullptr : fun->output_mask.data();
+    // Mirrored outputs are copied at the end
+    bool mirror = xcint_spin_symmetric(fun, input);
+    if (mirror)
+      mask = fun->spin_mask.data();
+    bool energy = xcint_wanted(mask, 0);
+    // The generated kernels are in double precision
+    bool generated = std::is_same<K, double>::value;
     switch (fun->order) {
       case 0: {
-        typedef ctaylor<ireal_t, 0> ttype;
+        if (!energy || (generated && xcint_eval_generated(fun, input, output, mask)))
+          break;
+        typedef ctaylor<K, 0> ttype;
         int inlen = xcint_vars[fun->vars].len;
-        ttype in[XC_MAX_INVARS], out = 0;
+        ttype in[XC_MAX_INVARS];
+        ctaylor<ireal_t, 0> out = 0;
         for (int i = 0; i < inlen; i++)
           in[i] = input[i];
         densvars<ttype> d(fun, in);
-        for (int i = 0; i < fun->nr_active_functionals; i++)
-          out += fun->settings[fun->active_functionals[i]->id] *
-                 fun->active_functionals[i]->fp0(d);
+        out += xcint_eval_functionals(fun, d);
         output[0] = out.get(CNST);
       } break;
 #if XCFUN_MAX_ORDER >= 1
       case 1: {
         int inlen = xcint_vars[fun->vars].len;
+        if (generated && xcint_eval_generated(fun, input, output, mask))
+          break;
+        if (std::is_same<K, ireal_t>::value && inlen >= XCINT_ADJOINT_MIN_VARS &&
+            xcint_eval_adjoint(fun, input, output, mask))
+          break;
         {
-          typedef ctaylor<ireal_t, 2> ttype2;
-          ttype2 in2[XC_MAX_INVARS], out2 = 0;
+          typedef ctaylor<K, 2> ttype2;
+          ttype2 in2[XC_MAX_INVARS];
+          ctaylor<ireal_t, 2> out2 = 0;
           for (int i = 0; i < inlen; i++)
             in2[i] = input[i];
           for (int j = 0; j < inlen / 2; j++) {
+            bool last = (j == inlen / 2 - 1) && !(inlen & 1);
+            if (!(xcint_wanted(mask, 2 * j + 1) || xcint_wanted(mask, 2 * j + 2) ||
+                  (energy && last)))
+              continue;
             in2[2 * j].set(VAR0, 1);
             in2[2 * j + 1].set(VAR1, 1);
             densvars<ttype2> d(fun, in2);
-            out2 = 0;
-            for (int i = 0; i < fun->nr_active_functionals; i++)
-              out2 += fun->settings[fun->active_functionals[i]->id] *
-                      fun->active_functionals[i]->fp2(d);
+            out2 = xcint_eval_functionals(fun, d);
             in2[2 * j] = input[2 * j];
             in2[2 * j + 1] = input[2 * j + 1];
-            output[2 * j + 1] = out2.get(VAR0); // First derivatives
-            output[2 * j + 2] = out2.get(VAR1); // First derivatives
+            if (xcint_wanted(mask, 2 * j + 1))
+              output[2 * j + 1] = out2.get(VAR0); // First derivatives
+            if (xcint_wanted(mask, 2 * j + 2))
+              output[2 * j + 2] = out2.get(VAR1); // First derivatives
+            if (energy) {
+              output[0] = out2.get(CNST); // Energy
+              energy = false;
+            }
           }
-          output[0] = out2.get(CNST); // Energy
         }
-        if (inlen & 1) {
-          typedef ctaylor<ireal_t, 1> ttype;
+        if ((inlen & 1) && (xcint_wanted(mask, inlen) || energy)) {
+          typedef ctaylor<K, 1> ttype;
           int inlen = xcint_vars[fun->vars].len;
-          ttype in[XC_MAX_INVARS], out = 0;
+          ttype in[XC_MAX_INVARS];
+          ctaylor<ireal_t, 1> out = 0;
           for (int i = 0; i < inlen; i++)
             in[i] = input[i];
           int j = inlen - 1;
           {
             in[j].set(VAR0, 1);
             densvars<ttype> d(fun, in);
-            out = 0;
-            for (int i = 0; i < fun->nr_active_functionals; i++)
-              out += fun->settings[fun->active_functionals[i]->id] *
-                     fun->active_functionals[i]->fp1(d);
+            out = xcint_eval_functionals(fun, d);
             in[j] = input[j];
-            output[j + 1] = out.get(VAR0); // First derivatives
+            if (xcint_wanted(mask, j + 1))
+              output[j + 1] = out.get(VAR0); // First derivatives
           }
-          output[0] = out.get(CNST); // Energy
+          if (energy)
+            output[0] = out.get(CNST); // Energy
         }
       } break;
 #endif
@@ -560,9 +1071,10 @@ void xcfun_eval(const XCFunctional * fun, const double input[], double output[])
       // Do the third order derivatives here, then use the second order code. This is
       // getting expensive..
       case 3: {
-        typedef ctaylor<ireal_t, 3> ttype;
+        xcint_workspace<K, 3> & w = xcint_thread_workspace<K, 3>(fun);
+        ctaylor<K, 3> * in = w.in;
         int inlen = xcint_vars[fun->vars].len;
-        ttype in[XC_MAX_INVARS], out = 0;
+        ctaylor<ireal_t, 3> out = 0;
         for (int i = 0; i < inlen; i++)
           in[i] = input[i];
         int k = 1 + inlen + (inlen * (inlen + 1)) / 2;
@@ -570,14 +1082,13 @@ void xcfun_eval(const XCFunctional * fun, const double input[], double output[])
           in[i].set(VAR0, 1);
           for (int j = i; j < inlen; j++) {
             in[j].set(VAR1, 1);
-            for (int s = j; s < inlen; s++) {
+            for (int s = j; s < inlen; s++, k++) {
+              if (!xcint_wanted(mask, k))
+                continue;
               in[s].set(VAR2, 1);
-              densvars<ttype> d(fun, in);
-              out = 0;
-              for (int n = 0; n < fun->nr_active_functionals; n++)
-                out += fun->settings[fun->active_functionals[n]->id] *
-                       fun->active_functionals[n]->fp3(d);
-              output[k++] = out.get(VAR0 | VAR1 | VAR2); // Third derivative
+              w.d.fill(in);
+              out = xcint_eval_functionals(fun, w.d);
+              output[k] = out.get(VAR0 | VAR1 | VAR2); // Third derivative
               in[s].set(VAR2, 0);
             }
             in[j].set(VAR1, 0);
@@ -587,48 +1098,63 @@ void xcfun_eval(const XCFunctional * fun, const double input[], double output[])
       }
 #endif
       case 2: {
-        typedef ctaylor<ireal_t, 2> ttype;
+        if (generated && xcint_eval_generated(fun, input, output, mask))
+          break;
+        typedef ctaylor<K, 2> ttype;
         int inlen = xcint_vars[fun->vars].len;
-        ttype in[XC_MAX_INVARS], out = 0;
+        ttype in[XC_MAX_INVARS];
+        ctaylor<ireal_t, 2> out = 0;
         for (int i = 0; i < inlen; i++)
           in[i] = input[i];
         int k = inlen + 1;
         for (int i = 0; i < inlen; i++) {
+          // Passes needed in this row besides the wanted second derivatives.
+          // The last variable gets the energy if no earlier pass gave it.
+          bool first = xcint_wanted(mask, i + 1);
+          bool row = first || (energy && i == inlen - 1);
           in[i].set(VAR0, 1);
-          for (int j = i; j < inlen; j++) {
+          for (int j = i; j < inlen; j++, k++) {
+            if (!(xcint_wanted(mask, k) || (row && j == inlen - 1)))
+              continue;
             in[j].set(VAR1, 1);
             densvars<ttype> d(fun, in);
-            out = 0;
-            for (int n = 0; n < fun->nr_active_functionals; n++)
-              out += fun->settings[fun->active_functionals[n]->id] *
-                     fun->active_functionals[n]->fp2(d);
-            output[k++] = out.get(VAR0 | VAR1); // Second derivative
+            out = xcint_eval_functionals(fun, d);
+            if (xcint_wanted(mask, k))
+              output[k] = out.get(VAR0 | VAR1); // Second derivative
             in[j].set(VAR1, 0);                 // slightly pessimized
+            if (first)
+              output[i + 1] = out.get(VAR0); // First derivative
+            if (energy) {
+              output[0] = out.get(CNST); // Energy
+              energy = false;
+            }
+            row = false;
           }
-          output[i + 1] = out.get(VAR0); // First derivative
           in[i] = input[i];
         }
-        output[0] = out.get(CNST); // Energy
       } break;
 #endif
       default:
         xcfun::die("FIXME: Order too high for partial derivatives in xc_eval",
                    fun->order);
     }
+    if (mirror)
+      for (size_t k = 0; k < fun->spin_mirror.size(); k++)
+        if (!fun->spin_mask[k] &&
+            (fun->output_mask.empty() || fun->output_mask[k]))
+          output[k] = output[fun->spin_mirror[k]];
   } else if (fun->mode == XC_CONTRACTED) {
 #define DOEVAL(N, E)                                                                \
   if (fun->order == N) {                                                            \
-    typedef ctaylor<ireal_t, N> ttype;                                              \
+    xcint_workspace<K, N> & w = xcint_thread_workspace<K, N>(fun);                  \
     int inlen = xcint_vars[fun->vars].len;                                          \
-    ttype in[XC_MAX_INVARS], out = 0;                                               \
+    ctaylor<ireal_t, N> out = 0;                                                    \
     int k = 0;                                                                      \
     for (int i = 0; i < inlen; i++)                                                 \
       for (int j = 0; j < (1 << fun->order); j++)                                   \
-        in[i].set(j, input[k++]);                                                   \
-    densvars<ttype> d(fun, in);                                                     \
-    for (int i = 0; i < fun->nr_active_functionals; i++)                            \
-      out += fun->settings[fun->active_functionals[i]->id] *                        \
-             fun->active_functionals[i]->fp##N(d);                                  \
+        w.in[i].set(j, input[k++]);                                                 \
+    w.d.fill(w.in);                                                                 \
+    out = xcint_eval_functionals(fun, w.d);                                         \
     for (int i = 0; i < (1 << fun->order); i++)                                     \
       output[i] = out.get(i);                                                       \
   } else
@@ -651,17 +1177,15 @@ void xcfun_eval(const XCFunctional * fun, const double input[], double output[])
         inpos = 10;
     }
     {
-      typedef ctaylor<ireal_t, 1> ttype;
-      ttype in[XC_MAX_INVARS], out = 0;
+      typedef ctaylor<K, 1> ttype;
+      ttype in[XC_MAX_INVARS];
+      ctaylor<ireal_t, 1> out = 0;
       for (int i = 0; i < inlen; i++)
         in[i] = input[i];
       for (int j = 0; j < npot; j++) {
         in[j * inpos].set(VAR0, 1);
         densvars<ttype> d(fun, in);
-        out = 0;
-        for (int i = 0; i < fun->nr_active_functionals; i++)
-          out += fun->settings[fun->active_functionals[i]->id] *
-                 fun->active_functionals[i]->fp1(d);
+        out = xcint_eval_functionals(fun, d);
         in[j * inpos] = input[j * inpos];
         output[j + 1] = out.get(VAR0); // First derivatives
       }
@@ -673,12 +1197,12 @@ void xcfun_eval(const XCFunctional * fun, const double input[], double output[])
       /*
          v = dE/dn - nabla.dE/dg
        */
-      typedef ctaylor<ireal_t, 2> ttype;
+      typedef ctaylor<K, 2> ttype;
       ttype in[XC_MAX_INVARS];
       // n gx gy gz xx xy xz yy yz zz
       // 0 1  2  3  4  5  6  7  8  9
       if (fun->vars == XC_A_2ND_TAYLOR || fun->vars == XC_N_2ND_TAYLOR) {
-        ttype out = 0;
+        ctaylor<ireal_t, 2> out = 0;
         // d/dx
         in[0] = ttype(input[0], VAR0, input[1]);
         for (int i = 0; i < 3; i++)
@@ -688,9 +1212,7 @@ void xcfun_eval(const XCFunctional * fun, const double input[], double output[])
         in[1].set(VAR1, 1); // d/dgx
         {
           densvars<ttype> d(fun, in);
-          for (int i = 0; i < fun->nr_active_functionals; i++)
-            out += fun->settings[fun->active_functionals[i]->id] *
-                   fun->active_functionals[i]->fp2(d);
+          out += xcint_eval_functionals(fun, d);
         }
 
         // d/dy
@@ -701,9 +1223,7 @@ void xcfun_eval(const XCFunctional * fun, const double input[], double output[])
         in[2].set(VAR1, 1); // d/dgy
         {
           densvars<ttype> d(fun, in);
-          for (int i = 0; i < fun->nr_active_functionals; i++)
-            out += fun->settings[fun->active_functionals[i]->id] *
-                   fun->active_functionals[i]->fp2(d);
+          out += xcint_eval_functionals(fun, d);
         }
         // d/dz
         in[0] = ttype(input[0], VAR0, input[3]);
@@ -713,9 +1233,7 @@ void xcfun_eval(const XCFunctional * fun, const double input[], double output[])
         in[3].set(VAR1, 1); // d/dgz
         {
           densvars<ttype> d(fun, in);
-          for (int i = 0; i < fun->nr_active_functionals; i++)
-            out += fun->settings[fun->active_functionals[i]->id] *
-                   fun->active_functionals[i]->fp2(d);
+          out += xcint_eval_functionals(fun, d);
         }
         output[1] -= out.get(
             VAR0 | VAR1); // Subtract divergence of dE/dg from lda part of potential
@@ -729,7 +1247,7 @@ void xcfun_eval(const XCFunctional * fun, const double input[], double output[])
         {
           // j = 0 alpha and j = 1 beta
           for (int j = 0; j < 2; j++) {
-            ttype out = 0;
+            ctaylor<ireal_t, 2> out = 0;
             // Point to the correct set of values from the input
             int offset = 10;
             // d/dx
@@ -746,9 +1264,7 @@ void xcfun_eval(const XCFunctional * fun, const double input[], double output[])
             in[1 + offset * j].set(VAR1, 1); // d/dgx(a/b)
             {
               densvars<ttype> d(fun, in);
-              for (int i = 0; i < fun->nr_active_functionals; i++)
-                out += fun->settings[fun->active_functionals[i]->id] *
-                       fun->active_functionals[i]->fp2(d);
+              out += xcint_eval_functionals(fun, d);
             }
             // d/dy
             in[0] = ttype(input[0], VAR0, input[2]);
@@ -762,9 +1278,7 @@ void xcfun_eval(const XCFunctional * fun, const double input[], double output[])
             in[2 + offset * j].set(VAR1, 1); // d/dgy(a/b)
             {
               densvars<ttype> d(fun, in);
-              for (int i = 0; i < fun->nr_active_functionals; i++)
-                out += fun->settings[fun->active_functionals[i]->id] *
-                       fun->active_functionals[i]->fp2(d);
+              out += xcint_eval_functionals(fun, d);
             }
             // d/dz
             in[0] = ttype(input[0], VAR0, input[3]);
@@ -778,9 +1292,7 @@ void xcfun_eval(const XCFunctional * fun, const double input[], double output[])
             in[3 + offset * j].set(VAR1, 1); // d/dgy(a/b)
             {
               densvars<ttype> d(fun, in);
-              for (int i = 0; i < fun->nr_active_functionals; i++)
-                out += fun->settings[fun->active_functionals[i]->id] *
-                       fun->active_functionals[i]->fp2(d);
+              out += xcint_eval_functionals(fun, d);
             }
             output[j + 1] -= out.get(
                 VAR0 |
@@ -795,6 +1307,158 @@ void xcfun_eval(const XCFunctional * fun, const double input[], double output[])
   }
 }
 
+// Second derivatives contracted with perturbed densities at a point. VAR0
+// carries the perturbation and VAR1 picks the variable, so the VAR0|VAR1
+// coefficient is one element of f_xc * rho_1.
+template <typename K>
+static void xcint_eval_kernel_contraction(const XCFunctional * fun,
+                                          const double input[],
+                                          int nr_perturbations,
+                                          const double perturbed[],
+                                          double output[]) {
+  typedef ctaylor<K, 2> ttype;
+  int inlen = xcint_vars[fun->vars].len;
+  ttype in[XC_MAX_INVARS];
+  for (int a = 0; a < nr_perturbations; a++) {
+    const double * pert = perturbed + a * inlen;
+    for (int j = 0; j < inlen; j++)
+      in[j] = ttype(input[j], VAR0, pert[j]);
+    for (int i = 0; i < inlen; i++) {
+      in[i].set(VAR1, 1);
+      densvars<ttype> d(fun, in);
+      ctaylor<ireal_t, 2> out = xcint_eval_functionals(fun, d);
+      output[a * inlen + i] = out.get(VAR0 | VAR1);
+      in[i].set(VAR1, 0);
+    }
+  }
+}
+
+// Energy, gradient and Hessian times direction[] at a point, one forward
+// pass for each variable
+template <typename K>
+static void xcint_eval_hessian_vector(const XCFunctional * fun,
+                                      const double input[],
+                                      const double direction[],
+                                      double output[]) {
+  typedef ctaylor<K, 2> ttype;
+  int inlen = xcint_vars[fun->vars].len;
+  ttype in[XC_MAX_INVARS];
+  for (int j = 0; j < inlen; j++)
+    in[j] = ttype(input[j], VAR0, direction[j]);
+  for (int i = 0; i < inlen; i++) {
+    in[i].set(VAR1, 1);
+    densvars<ttype> d(fun, in);
+    ctaylor<ireal_t, 2> out = xcint_eval_functionals(fun, d);
+    output[0] = out.get(CNST);
+    output[1 + i] = out.get(VAR1);
+    output[1 + inlen + i] = out.get(VAR0 | VAR1);
+    in[i].set(VAR1, 0);
+  }
+}
+
+// The same in one forward and one backward sweep, forward over reverse mode
+// with adjoint<ctaylor<ireal_t, 1>>. Returns false, without output, if an
+// active functional has no such kernel or uses an LDA table.
+static bool xcint_eval_hessian_vector_adjoint(const XCFunctional * fun,
+                                              const double input[],
+                                              const double direction[],
+                                              double output[]) {
+  typedef ctaylor<ireal_t, 1> ttype;
+  for (int i = 0; i < fun->nr_active_functionals; i++)
+    if (!fun->active_terms[i].kernels->fphv || fun->lda_tables[i])
+      return false;
+  static thread_local adjoint_tape<ttype> tape;
+  static thread_local std::vector<ttype> adj;
+  int inlen = xcint_vars[fun->vars].len;
+  adjoint<ttype> in[XC_MAX_INVARS];
+  tape.clear();
+  for (int i = 0; i < inlen; i++) {
+    ttype x = input[i];
+    x.set(VAR0, direction[i]);
+    in[i] = tape.variable(x);
+  }
+  densvars<adjoint<ttype>> d(fun, in);
+  adjoint<ttype> out = 0;
+  for (int i = 0; i < fun->nr_active_functionals; i++) {
+    const functional_data * f = fun->active_terms[i].kernels;
+#ifdef XCFUN_ENABLE_PROFILING
+    unsigned long long start = fun->profile ? xcint_cycles() : 0;
+#endif
+    adjoint<ttype> e = f->fphv(d);
+#ifdef XCFUN_ENABLE_PROFILING
+    if (fun->profile) {
+      xcint_profile_entry & p = fun->profile->at(fun, fun->active_ids[i]);
+      p.calls.fetch_add(1, std::memory_order_relaxed);
+      p.cycles.fetch_add(xcint_cycles() - start, std::memory_order_relaxed);
+    }
+#endif
+    out += fun->active_terms[i].weight * e;
+  }
+  adj.resize(tape.nodes.size());
+  tape.gradient(adj.data(), out);
+  output[0] = out.value.get(CNST);
+  for (int i = 0; i < inlen; i++) {
+    output[1 + i] = adj[in[i].index].get(CNST);
+    output[1 + inlen + i] = adj[in[i].index].get(VAR0);
+  }
+  return true;
+}
+
+// Energy density at a point, with the variables of any setup
+template <typename K>
+static double xcint_eval_energy(const XCFunctional * fun, const double input[]) {
+  typedef ctaylor<K, 0> ttype;
+  int inlen = xcint_vars[fun->vars].len;
+  int step = (fun->mode == XC_CONTRACTED) ? 1 << fun->order : 1;
+  ttype in[XC_MAX_INVARS];
+  for (int i = 0; i < inlen; i++)
+    in[i] = input[i * step];
+  densvars<ttype> d(fun, in);
+  return xcint_eval_functionals(fun, d).get(CNST);
+}
+
+// Total density of the input, without the regularization of densvars so
+// that the integrated electrons are those of the input
+static double xcint_input_density(xcfun_vars vars, const double input[], int step) {
+  switch (vars) {
+    case XC_A_B:
+    case XC_A_B_GAA_GAB_GBB:
+    case XC_A_B_GAA_GAB_GBB_LAPA_LAPB:
+    case XC_A_B_GAA_GAB_GBB_TAUA_TAUB:
+    case XC_A_B_GAA_GAB_GBB_LAPA_LAPB_TAUA_TAUB:
+    case XC_A_B_GAA_GAB_GBB_LAPA_LAPB_TAUA_TAUB_JPAA_JPBB:
+    case XC_A_B_AX_AY_AZ_BX_BY_BZ:
+    case XC_A_B_AX_AY_AZ_BX_BY_BZ_TAUA_TAUB:
+      return input[0] + input[step];
+    case XC_A_B_2ND_TAYLOR:
+      return input[0] + input[10 * step];
+    default: // n, or the alpha density alone
+      return input[0];
+  }
+}
+
+void xcfun_eval(const XCFunctional * fun, const double input[], double output[]) {
+  if (fun->mode == XC_MODE_UNSET)
+    xcfun::die("xc_eval() called before a mode was successfully set", 0);
+  if (fun->vars == XC_VARS_UNSET)
+    xcfun::die("xc_eval() called before variables were successfully set", 0);
+  if (fun->order == -1 && fun->mode != XC_POTENTIAL)
+    xcfun::die("xc_eval() called before the order was successfully set", 0);
+#ifdef XCFUN_ENABLE_PROFILING
+  if (fun->profile)
+    for (int i = 0; i < fun->nr_active_functionals; i++)
+      fun->profile->at(fun, fun->active_ids[i])
+          .points.fetch_add(1, std::memory_order_relaxed);
+#endif
+#ifdef XCFUN_ENABLE_SINGLE
+  if (fun->single_precision) {
+    xcint_eval<float>(fun, input, output);
+    return;
+  }
+#endif
+  xcint_eval<ireal_t>(fun, input, output);
+}
+
 void xcfun_eval_vec(const XCFunctional * fun,
                     int nr_points,
                     const double density[],
@@ -804,6 +1468,262 @@ void xcfun_eval_vec(const XCFunctional * fun,
   for (int i = 0; i < nr_points; i++)
     xcfun_eval(fun, density + i * density_pitch, result + i * result_pitch);
 }
+
+int xcfun_eval_vec_weighted(const XCFunctional * fun,
+                            int nr_points,
+                            const double density[],
+                            int density_pitch,
+                            const double weights[],
+                            double result[],
+                            int result_pitch) {
+  if (!fun->eval_ready)
+    return xcfun::XC_ESETUP;
+  // Each point goes through a buffer in cache, so result is written once
+  int nout = xcfun_output_length(fun);
+  std::vector<double> out(nout);
+  for (int p = 0; p < nr_points; p++) {
+    double * r = result + static_cast<std::ptrdiff_t>(p) * result_pitch;
+    const double * d = density + static_cast<std::ptrdiff_t>(p) * density_pitch;
+    xcfun_eval(fun, d, out.data());
+    for (int k = 0; k < nout; k++)
+      if (fun->output_mask.empty() || fun->output_mask[k])
+        r[k] = weights[p] * out[k];
+  }
+  return 0;
+}
+
+int xcfun_set_output_mask(XCFunctional * fun, const int mask[]) {
+  if (!fun->eval_ready || fun->mode != XC_PARTIAL_DERIVATIVES)
+    return -1;
+  if (mask)
+    fun->output_mask.assign(mask, mask + xcfun_output_length(fun));
+  else
+    fun->output_mask.clear();
+  xcint_spin_setup(fun);
+  return 0;
+}
+
+int xcfun_try_eval(const XCFunctional * fun, const double input[], double output[]) {
+  if (!fun->eval_ready)
+    return xcfun::XC_ESETUP;
+  xcfun_eval(fun, input, output);
+  return 0;
+}
+
+int xcfun_try_eval_vec(const XCFunctional * fun,
+                       int nr_points,
+                       const double density[],
+                       int density_pitch,
+                       double result[],
+                       int result_pitch) {
+  if (!fun->eval_ready)
+    return xcfun::XC_ESETUP;
+  xcfun_eval_vec(fun, nr_points, density, density_pitch, result, result_pitch);
+  return 0;
+}
+
+void xcfun_eval_vec_strided(const XCFunctional * fun,
+                            int nr_points,
+                            const double density[],
+                            int density_pitch,
+                            int density_stride,
+                            double result[],
+                            int result_pitch,
+                            int result_stride) {
+  if (density_stride == 1 && result_stride == 1) {
+    xcfun_eval_vec(fun, nr_points, density, density_pitch, result, result_pitch);
+    return;
+  }
+  // Gather and scatter one point at a time through contiguous buffers
+  int inlen = xcint_eval_input_length(fun);
+  std::vector<double> in(inlen), out(xcfun_output_length(fun));
+  for (int i = 0; i < nr_points; i++) {
+    const double * d = density + static_cast<std::ptrdiff_t>(i) * density_pitch;
+    double * r = result + static_cast<std::ptrdiff_t>(i) * result_pitch;
+    for (int j = 0; j < inlen; j++)
+      in[j] = d[j * density_stride];
+    xcfun_eval(fun, in.data(), out.data());
+    for (std::size_t j = 0; j < out.size(); j++)
+      if (fun->output_mask.empty() || fun->output_mask[j])
+        r[j * result_stride] = out[j];
+  }
+}
+
+// Copy one output of a block of points to a plane row. Aligned pairs are
+// written with non-temporal stores, the planes are not read back soon.
+static void xcint_store_row(double * row, const double * out, int nout, int n) {
+  int p = 0;
+#ifdef __SSE2__
+  if (reinterpret_cast<std::uintptr_t>(row) % 16 == 0)
+    for (; p + 1 < n; p += 2)
+      _mm_stream_pd(row + p, _mm_set_pd(out[(p + 1) * nout], out[p * nout]));
+#endif
+  for (; p < n; p++)
+    row[p] = out[p * nout];
+}
+
+int xcfun_eval_vec_planes(const XCFunctional * fun,
+                          int nr_points,
+                          const double density[],
+                          int density_pitch,
+                          double * planes[],
+                          int plane_pitch) {
+  if (!fun->eval_ready)
+    return xcfun::XC_ESETUP;
+  if (fun->mode != XC_PARTIAL_DERIVATIVES || nr_points < 0 ||
+      plane_pitch < nr_points)
+    return -1;
+  // Points are evaluated in blocks which stay in cache, then transposed
+  const int block = 64;
+  int inlen = xcint_vars[fun->vars].len;
+  int nout = xcfun_output_length(fun);
+  std::vector<double> out(block * nout);
+  for (int p0 = 0; p0 < nr_points; p0 += block) {
+    int n = std::min(block, nr_points - p0);
+    for (int p = 0; p < n; p++)
+      xcfun_eval(fun,
+                 density + static_cast<std::ptrdiff_t>(p0 + p) * density_pitch,
+                 &out[p * nout]);
+    // Outputs of order k follow those of order k - 1
+    int first = 0, count = 1;
+    for (int k = 0; k <= fun->order; k++) {
+      for (int c = 0; planes[k] && c < count; c++) {
+        double * row = planes[k] + static_cast<std::ptrdiff_t>(c) * plane_pitch;
+        if (fun->output_mask.empty() || fun->output_mask[first + c])
+          xcint_store_row(row + p0, &out[first + c], nout, n);
+      }
+      first += count;
+      count = count * (inlen + k) / (k + 1);
+    }
+  }
+#ifdef __SSE2__
+  _mm_sfence();
+#endif
+  return 0;
+}
+
+int xcfun_eval_kernel_contraction(const XCFunctional * fun,
+                                  int nr_points,
+                                  const double density[],
+                                  int density_pitch,
+                                  int nr_perturbations,
+                                  const double perturbed[],
+                                  int perturbed_pitch,
+                                  double result[],
+                                  int result_pitch) {
+  if (!fun->eval_ready)
+    return xcfun::XC_ESETUP;
+  if (fun->mode != XC_PARTIAL_DERIVATIVES || fun->order != 2 ||
+      nr_perturbations < 0)
+    return -1;
+  for (int p = 0; p < nr_points; p++) {
+    const double * d = density + static_cast<std::ptrdiff_t>(p) * density_pitch;
+    const double * q = perturbed + static_cast<std::ptrdiff_t>(p) * perturbed_pitch;
+    double * r = result + static_cast<std::ptrdiff_t>(p) * result_pitch;
+#ifdef XCFUN_ENABLE_PROFILING
+    if (fun->profile)
+      for (int i = 0; i < fun->nr_active_functionals; i++)
+        fun->profile->at(fun, fun->active_ids[i])
+            .points.fetch_add(1, std::memory_order_relaxed);
+#endif
+#ifdef XCFUN_ENABLE_SINGLE
+    if (fun->single_precision) {
+      xcint_eval_kernel_contraction<float>(fun, d, nr_perturbations, q, r);
+      continue;
+    }
+#endif
+    // Each perturbation is a Hessian-vector product, one sweep if possible
+    int inlen = xcint_vars[fun->vars].len;
+    double hv[1 + 2 * XC_MAX_INVARS];
+    int a = 0;
+    for (; a < nr_perturbations; a++) {
+      if (!xcint_eval_hessian_vector_adjoint(fun, d, q + a * inlen, hv))
+        break;
+      for (int i = 0; i < inlen; i++)
+        r[a * inlen + i] = hv[1 + inlen + i];
+    }
+    if (a < nr_perturbations)
+      xcint_eval_kernel_contraction<ireal_t>(fun, d, nr_perturbations, q, r);
+  }
+  return 0;
+}
+
+int xcfun_eval_hessian_vector(const XCFunctional * fun,
+                              int nr_points,
+                              const double density[],
+                              int density_pitch,
+                              const double direction[],
+                              int direction_pitch,
+                              double result[],
+                              int result_pitch) {
+  if (!fun->eval_ready)
+    return xcfun::XC_ESETUP;
+  if (fun->mode != XC_PARTIAL_DERIVATIVES || fun->order != 2)
+    return -1;
+  for (int p = 0; p < nr_points; p++) {
+    const double * d = density + static_cast<std::ptrdiff_t>(p) * density_pitch;
+    const double * v = direction + static_cast<std::ptrdiff_t>(p) * direction_pitch;
+    double * r = result + static_cast<std::ptrdiff_t>(p) * result_pitch;
+#ifdef XCFUN_ENABLE_PROFILING
+    if (fun->profile)
+      for (int i = 0; i < fun->nr_active_functionals; i++)
+        fun->profile->at(fun, fun->active_ids[i])
+            .points.fetch_add(1, std::memory_order_relaxed);
+#endif
+#ifdef XCFUN_ENABLE_SINGLE
+    if (fun->single_precision) {
+      xcint_eval_hessian_vector<float>(fun, d, v, r);
+      continue;
+    }
+#endif
+    if (!xcint_eval_hessian_vector_adjoint(fun, d, v, r))
+      xcint_eval_hessian_vector<ireal_t>(fun, d, v, r);
+  }
+  return 0;
+}
+
+int xcfun_eval_integrate(const XCFunctional * fun,
+                         int nr_points,
+                         const double density[],
+                         int density_pitch,
+                         const double weights[],
+                         double * energy,
+                         double * electrons) {
+  if (!fun->eval_ready)
+    return xcfun::XC_ESETUP;
+  for (int i = 0; i < fun->nr_active_functionals; i++)
+    if (!xcint_has_kernel(*fun->active_terms[i].kernels, 0))
+      return xcfun::XC_EORDER;
+  int step = (fun->mode == XC_CONTRACTED) ? 1 << fun->order : 1;
+  xcint_sum energy_sum, electron_sum;
+  for (int p0 = 0; p0 < nr_points; p0 += xcfun::XC_SUM_BLOCK) {
+    xcint_sum energy_block, electron_block;
+    for (int p = p0; p < std::min(p0 + xcfun::XC_SUM_BLOCK, nr_points); p++) {
+      const double * d = density + static_cast<std::ptrdiff_t>(p) * density_pitch;
+      double e;
+#ifdef XCFUN_ENABLE_PROFILING
+      if (fun->profile)
+        for (int i = 0; i < fun->nr_active_functionals; i++)
+          fun->profile->at(fun, fun->active_ids[i])
+              .points.fetch_add(1, std::memory_order_relaxed);
+#endif
+#ifdef XCFUN_ENABLE_SINGLE
+      if (fun->single_precision)
+        e = xcint_eval_energy<float>(fun, d);
+      else
+#endif
+        e = xcint_eval_energy<ireal_t>(fun, d);
+      energy_block.add(weights[p] * e);
+      electron_block.add(weights[p] * xcint_input_density(fun->vars, d, step));
+    }
+    energy_sum.add(energy_block.value());
+    electron_sum.add(electron_block.value());
+  }
+  *energy = energy_sum.value();
+  if (electrons)
+    *electrons = electron_sum.value();
+  return 0;
+}
 } // namespace xcfun
 
 xcfun_t * xcfun_new() { return AS_TYPE(xcfun_t, xcfun::xcfun_new()); }
@@ -818,6 +1738,49 @@ int xcfun_get(const xcfun_t * fun, const char * name, double * value) {
   return xcfun::xcfun_get(AS_CTYPE(XCFunctional, fun), name, value);
 }
 
+int xcfun_set_lda_tables(xcfun_t * fun, double tolerance) {
+  return xcfun::xcfun_set_lda_tables(AS_TYPE(XCFunctional, fun), tolerance);
+}
+
+int xcfun_set_single_precision(xcfun_t * fun, bool single) {
+  return xcfun::xcfun_set_single_precision(AS_TYPE(XCFunctional, fun), single);
+}
+
+int xcfun_set_spin_symmetry(xcfun_t * fun, bool symmetric) {
+  return xcfun::xcfun_set_spin_symmetry(AS_TYPE(XCFunctional, fun), symmetric);
+}
+
+int xcfun_set_generated_kernels(xcfun_t * fun, bool generated) {
+  return xcfun::xcfun_set_generated_kernels(AS_TYPE(XCFunctional, fun), generated);
+}
+
+bool xcfun_uses_generated_kernels(const xcfun_t * fun) {
+  return xcfun::xcfun_uses_generated_kernels(AS_CTYPE(XCFunctional, fun));
+}
+
+int xcfun_set_jit(xcfun_t * fun, bool jit) {
+  return xcfun::xcfun_set_jit(AS_TYPE(XCFunctional, fun), jit);
+}
+
+bool xcfun_uses_jit(const xcfun_t * fun) {
+  return xcfun::xcfun_uses_jit(AS_CTYPE(XCFunctional, fun));
+}
+
+int xcfun_get_profile(const xcfun_t * fun,
+                      const char * name,
+                      xcfun_mode mode,
+                      int order,
+                      unsigned long long * points,
+                      unsigned long long * calls,
+                      unsigned long long * cycles) {
+  return xcfun::xcfun_get_profile(
+      AS_CTYPE(XCFunctional, fun), name, mode, order, points, calls, cycles);
+}
+
+void xcfun_reset_profile(xcfun_t * fun) {
+  xcfun::xcfun_reset_profile(AS_TYPE(XCFunctional, fun));
+}
+
 bool xcfun_is_gga(const xcfun_t * fun) {
   return xcfun::xcfun_is_gga(AS_CTYPE(XCFunctional, fun));
 }
@@ -875,3 +1838,127 @@ void xcfun_eval_vec(const xcfun_t * fun,
                         result,
                         result_pitch);
 }
+
+void xcfun_eval_vec_strided(const xcfun_t * fun,
+                            int nr_points,
+                            const double density[],
+                            int density_pitch,
+                            int density_stride,
+                            double result[],
+                            int result_pitch,
+                            int result_stride) {
+  xcfun::xcfun_eval_vec_strided(AS_CTYPE(XCFunctional, fun),
+                                nr_points,
+                                density,
+                                density_pitch,
+                                density_stride,
+                                result,
+                                result_pitch,
+                                result_stride);
+}
+
+int xcfun_eval_vec_planes(const xcfun_t * fun,
+                          int nr_points,
+                          const double density[],
+                          int density_pitch,
+                          double * planes[],
+                          int plane_pitch) {
+  return xcfun::xcfun_eval_vec_planes(AS_CTYPE(XCFunctional, fun),
+                                      nr_points,
+                                      density,
+                                      density_pitch,
+                                      planes,
+                                      plane_pitch);
+}
+
+int xcfun_eval_kernel_contraction(const xcfun_t * fun,
+                                  int nr_points,
+                                  const double density[],
+                                  int density_pitch,
+                                  int nr_perturbations,
+                                  const double perturbed[],
+                                  int perturbed_pitch,
+                                  double result[],
+                                  int result_pitch) {
+  return xcfun::xcfun_eval_kernel_contraction(AS_CTYPE(XCFunctional, fun),
+                                              nr_points,
+                                              density,
+                                              density_pitch,
+                                              nr_perturbations,
+                                              perturbed,
+                                              perturbed_pitch,
+                                              result,
+                                              result_pitch);
+}
+
+int xcfun_eval_hessian_vector(const xcfun_t * fun,
+                              int nr_points,
+                              const double density[],
+                              int density_pitch,
+                              const double direction[],
+                              int direction_pitch,
+                              double result[],
+                              int result_pitch) {
+  return xcfun::xcfun_eval_hessian_vector(AS_CTYPE(XCFunctional, fun),
+                                          nr_points,
+                                          density,
+                                          density_pitch,
+                                          direction,
+                                          direction_pitch,
+                                          result,
+                                          result_pitch);
+}
+
+int xcfun_eval_integrate(const xcfun_t * fun,
+                         int nr_points,
+                         const double density[],
+                         int density_pitch,
+                         const double weights[],
+                         double * energy,
+                         double * electrons) {
+  return xcfun::xcfun_eval_integrate(AS_CTYPE(XCFunctional, fun),
+                                     nr_points,
+                                     density,
+                                     density_pitch,
+                                     weights,
+                                     energy,
+                                     electrons);
+}
+
+int xcfun_eval_vec_weighted(const xcfun_t * fun,
+                            int nr_points,
+                            const double density[],
+                            int density_pitch,
+                            const double weights[],
+                            double result[],
+                            int result_pitch) {
+  return xcfun::xcfun_eval_vec_weighted(AS_CTYPE(XCFunctional, fun),
+                                        nr_points,
+                                        density,
+                                        density_pitch,
+                                        weights,
+                                        result,
+                                        result_pitch);
+}
+
+int xcfun_set_output_mask(xcfun_t * fun, const int mask[]) {
+  return xcfun::xcfun_set_output_mask(AS_TYPE(XCFunctional, fun), mask);
+}
+
+int xcfun_try_eval(const xcfun_t * fun, const double input[], double output[]) {
+  return xcfun::xcfun_try_eval(AS_CTYPE(XCFunctional, fun), input, output);
+}
+
+int xcfun_try_eval_vec(const xcfun_t * fun,
+                       int nr_points,
+                       const double density[],
+                       int density_pitch,
+                       double result[],
+                       int result_pitch) {
+  return xcfun::xcfun_try_eval_vec(AS_CTYPE(XCFunctional, fun),
+                                   nr_points,
+                                   density,
+                                   density_pitch,
+                                   result,
+                                   result_pitch);
+}
@@ -15,11 +15,26 @@
 #pragma once
 
 #include <array>
+#include <cmath>
+#include <memory>
+#include <vector>
 
 #include "XCFun/xcfun.h"
 #include "functionals/list_of_functionals.hpp"
 
 struct functional_data;
+struct lda_table;
+struct xcint_profile;
+
+// Generated kernel of one functional, adding weight times its partial
+// derivatives at the point d to out. See xcint_generated_kernel().
+typedef void (*xcint_generated_fn)(double weight, const double d[], double out[]);
+
+// One term of the mixture, weight times the functional of the kernels
+struct xcint_term {
+  const functional_data * kernels;
+  double weight;
+};
 
 /*! \brief Exchange-correlation functional
  */
@@ -31,8 +46,33 @@ struct XCFunctional {
   int depends{0}; // XC_DENSITY, gradient etc
   xcfun_mode mode{XC_MODE_UNSET};
   xcfun_vars vars{XC_VARS_UNSET};
-  std::array<functional_data *, XC_NR_FUNCTIONALS> active_functionals{{nullptr}};
+  bool eval_ready{false}; // Checked setup, see xcfun_try_eval()
+  // Partial derivatives to compute, all if empty. See xcfun_set_output_mask()
+  std::vector<char> output_mask;
+  // Alpha/beta exchange of the inputs and outputs, and the outputs computed at
+  // spin symmetric points. Empty unless enabled with xcfun_set_spin_symmetry()
+  bool spin_symmetry{false};
+  std::vector<int> spin_swap, spin_mirror;
+  std::vector<char> spin_mask;
+  // The active functionals, with the kernels and weight of each term in the
+  // order they were set. Their ids are kept apart, for setup and queries.
+  std::array<xcint_term, XC_NR_FUNCTIONALS> active_terms;
+  std::array<xcfun_functional_id, XC_NR_FUNCTIONALS> active_ids;
   std::array<double, XC_NR_PARAMETERS_AND_FUNCTIONALS> settings{{0.0}};
+  bool single_precision{false};    // Kernels in float, see XCFUN_ENABLE_SINGLE
+  double lda_table_tolerance{0.0}; // Zero means analytic kernels only
+  // Interpolation tables for the active functionals, set up by xcfun_eval_setup
+  std::array<std::shared_ptr<const lda_table>, XC_NR_FUNCTIONALS> lda_tables;
+  // Straight-line kernels of the active functionals for the current setup,
+  // used if generated_kernels is set. See XCFUN_ENABLE_CODEGEN
+  bool generated_kernels{false};
+  std::array<xcint_generated_fn, XC_NR_FUNCTIONALS> generated{{nullptr}};
+  // Straight-line kernel of the whole mixture for the current setup, compiled
+  // at run time if jit_kernels is set. See XCFUN_ENABLE_JIT
+  bool jit_kernels{false};
+  xcint_generated_fn jit{nullptr};
+  // Evaluation counters, only allocated with XCFUN_ENABLE_PROFILING
+  std::shared_ptr<xcint_profile> profile;
 };
 
 namespace xcfun {
@@ -45,11 +85,49 @@ constexpr auto XC_EVARS = 2;
 /*! Invalid mode for functional type (ie. potential for mgga) */
 constexpr auto XC_EMODE = 4;
 
+/*! No valid evaluation setup (ie. functional added after xcfun_eval_setup) */
+constexpr auto XC_ESETUP = 8;
+
+/*! Points summed together by xcfun_eval_integrate before the block sums are
+    added. Splitting the points at block boundaries gives the same result. */
+constexpr auto XC_SUM_BLOCK = 256;
+
 /// \cond DEV
+// Compensated (Neumaier) sum of the grid reductions
+struct xcint_sum {
+  double sum{0.0};
+  double compensation{0.0};
+
+  void add(double x) {
+    double t = sum + x;
+    if (std::abs(sum) >= std::abs(x))
+      compensation += (sum - t) + x;
+    else
+      compensation += (x - t) + sum;
+    sum = t;
+  }
+  double value() const { return sum + compensation; }
+};
+
 XCFun_API XCFunctional * xcfun_new();
 XCFun_API void xcfun_delete(XCFunctional *);
 XCFun_API int xcfun_set(XCFunctional * fun, const char * name, double value);
 XCFun_API int xcfun_get(const XCFunctional * fun, const char * name, double * value);
+XCFun_API int xcfun_set_lda_tables(XCFunctional * fun, double tolerance);
+XCFun_API int xcfun_set_single_precision(XCFunctional * fun, bool single);
+XCFun_API int xcfun_set_spin_symmetry(XCFunctional * fun, bool symmetric);
+XCFun_API int xcfun_set_generated_kernels(XCFunctional * fun, bool generated);
+XCFun_API bool xcfun_uses_generated_kernels(const XCFunctional * fun);
+XCFun_API int xcfun_set_jit(XCFunctional * fun, bool jit);
+XCFun_API bool xcfun_uses_jit(const XCFunctional * fun);
+XCFun_API int xcfun_get_profile(const XCFunctional * fun,
+                                const char * name,
+                                xcfun_mode mode,
+                                int order,
+                                unsigned long long * points,
+                                unsigned long long * calls,
+                                unsigned long long * cycles);
+XCFun_API void xcfun_reset_profile(XCFunctional * fun);
 XCFun_API bool xcfun_is_gga(const XCFunctional * fun);
 XCFun_API bool xcfun_is_metagga(const XCFunctional * fun);
 XCFun_API int xcfun_eval_setup(XCFunctional * fun,
@@ -76,5 +154,60 @@ XCFun_API void xcfun_eval_vec(const XCFunctional * fun,
                               int density_pitch,
                               double result[],
                               int result_pitch);
+XCFun_API int xcfun_eval_vec_planes(const XCFunctional * fun,
+                                    int nr_points,
+                                    const double density[],
+                                    int density_pitch,
+                                    double * planes[],
+                                    int plane_pitch);
+XCFun_API int xcfun_eval_kernel_contraction(const XCFunctional * fun,
+                                            int nr_points,
+                                            const double density[],
+                                            int density_pitch,
+                                            int nr_perturbations,
+                                            const double perturbed[],
+                                            int perturbed_pitch,
+                                            double result[],
+                                            int result_pitch);
+XCFun_API int xcfun_eval_hessian_vector(const XCFunctional * fun,
+                                        int nr_points,
+                                        const double density[],
+                                        int density_pitch,
+                                        const double direction[],
+                                        int direction_pitch,
+                                        double result[],
+                                        int result_pitch);
+XCFun_API int xcfun_eval_integrate(const XCFunctional * fun,
+                                   int nr_points,
+                                   const double density[],
+                                   int density_pitch,
+                                   const double weights[],
+                                   double * energy,
+                                   double * electrons);
+XCFun_API int xcfun_eval_vec_weighted(const XCFunctional * fun,
+                                      int nr_points,
+                                      const double density[],
+                                      int density_pitch,
+                                      const double weights[],
+                                      double result[],
+                                      int result_pitch);
+XCFun_API int xcfun_set_output_mask(XCFunctional * fun, const int mask[]);
+XCFun_API int xcfun_try_eval(const XCFunctional * fun,
+                             const double input[],
+                             double output[]);
+XCFun_API int xcfun_try_eval_vec(const XCFunctional * fun,
+                                 int nr_points,
+                                 const double density[],
+                                 int density_pitch,
+                                 double result[],
+                                 int result_pitch);
+XCFun_API void xcfun_eval_vec_strided(const XCFunctional * fun,
+                                      int nr_points,
+                                      const double density[],
+                                      int density_pitch,
+                                      int density_stride,
+                                      double result[],
+                                      int result_pitch,
+                                      int result_stride);
 /// \endcond
 } // namespace xcfun
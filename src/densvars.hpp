@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <utility>
+
 #include "XCFunctional.hpp"
 #include "config.hpp"
 
@@ -29,6 +31,9 @@ template <typename T> static void regularize(T & x) {
     x = xcfun::XCFUN_TINY_DENSITY;
 }
 
+// Keeps the place on the tape, like the derivatives above
+template <typename T> void regularize(adjoint<T> & x) { regularize(x.value); }
+
 // Variables for expressing functionals, these are redundant because
 // different functionals have different needs.
 // TODO: Make sure all variables are handled in the switch.
@@ -37,7 +42,29 @@ template <typename T> struct densvars {
   // depends on vars.
   densvars(const XCFunctional * parent, const T * d) {
     this->parent = parent;
-    switch (parent->vars) {
+    fill(d);
+  }
+
+  // All variables zero, to be set by fill()
+  explicit densvars(const XCFunctional * parent) { this->parent = parent; }
+
+  // Refills the variables in place, so that the point loops reuse one object
+  void fill(const T * __restrict d) {
+    if (!unpack(parent->vars, d))
+      xcfun::die("Illegal/Not yet implemented vars value in densvars()",
+                 parent->vars);
+    zeta = s / n;
+    n_thirds = pow_thirds(n);
+    n_m13 = n_thirds(-1);
+    r_s = cbrt(3.0 / (4.0 * M_PI)) * n_m13;
+    a_43 = pow_thirds(a)(4);
+    b_43 = pow_thirds(b)(4);
+  }
+
+  // Sets the variables given by vars from d, false if vars is not handled.
+  // xcint_densvars_supported() asks this switch which vars are.
+  bool unpack(xcfun_vars vars, const T * __restrict d) {
+    switch (vars) {
       case XC_A_GAA:
         gaa = d[1];
         gab = 0;
@@ -46,10 +73,12 @@ template <typename T> struct densvars {
         gss = gaa;
         gns = gaa;
       case XC_A:
+        a = d[0];
+        regularize(a);
         b = 0;
-        n = a;
-        regularize(n);
-        s = n;
+        regularize(b);
+        n = a + b;
+        s = a - b;
         break;
       case XC_A_B_GAA_GAB_GBB_TAUA_TAUB:
         taua = d[5];
@@ -207,14 +236,9 @@ template <typename T> struct densvars {
         s = a - b;
         break;
       default:
-        xcfun::die("Illegal/Not yet implemented vars value in densvars()",
-                   parent->vars);
+        return false;
     }
-    zeta = s / n;
-    r_s = pow(3.0 / (n * 4.0 * M_PI), 1.0 / 3.0); // (3/4pi)^1/3*n^(-1/3) !check
-    n_m13 = pow(n, -1.0 / 3.0);
-    a_43 = pow(a, 4.0 / 3.0);
-    b_43 = pow(b, 4.0 / 3.0);
+    return true;
   }
 
   const XCFunctional * parent{nullptr};
@@ -240,6 +264,8 @@ template <typename T> struct densvars {
   T n_m13{static_cast<T>(0)}; /// pow(n,-1.0/3.0)
   T a_43{static_cast<T>(0)};
   T b_43{static_cast<T>(0)}; /// pow(a,4.0/3.0), pow(b,4.0/3.0)
+  /// n_thirds(k) is pow(n,k/3.0), sharing one cbrt between the powers
+  decltype(pow_thirds(std::declval<T>())) n_thirds;
   T jpaa{static_cast<T>(0)}; /// square of the alpha paramagnetic current vector.
   T jpbb{static_cast<T>(0)}; /// square of the beta paramagnetic current vector.
 };
@@ -17,11 +17,102 @@
 #include "specmath.hpp"
 #include "xcint.hpp"
 
+#if defined(XCFUN_CODEGEN)
 #define FUNCTIONAL(F)                                                               \
-  template <> const char * fundat_db<F>::symbol = #F;                               \
-  template <> functional_data fundat_db<F>::d
-#define EN(N, FUN) FUN<ctaylor<ireal_t, N>>,
-#define ENERGY_FUNCTION(FUN) FOR_EACH(XCFUN_MAX_ORDER, EN, FUN)
+  template <> const char * codegen_fundat_db<F>::symbol = #F;                       \
+  template <> const codegen_functional_data codegen_fundat_db<F>::d
+#elif defined(XCFUN_ISA)
+#define FUNCTIONAL(F) template <> const functional_definition isa_fundat_db<F>::d
+#else
+#define FUNCTIONAL(F)                                                               \
+  template <> const char fundat_db<F>::symbol[] = #F;                               \
+  template <> const functional_definition fundat_db<F>::d
+#endif
+// Kernel orders compiled for this file, restricted in selective builds by
+// a wrapper generated in src/functionals/CMakeLists.txt. Kernels outside
+// the range are left empty.
+#ifndef XCFUN_KERNEL_MIN_ORDER
+#define XCFUN_KERNEL_MIN_ORDER 0
+#endif
+#ifndef XCFUN_KERNEL_MAX_ORDER
+#define XCFUN_KERNEL_MAX_ORDER XCFUN_MAX_ORDER
+#endif
+#if XCFUN_KERNEL_MIN_ORDER <= 0 && XCFUN_KERNEL_MAX_ORDER >= 0
+#define EN_0(FUN, T) FUN<ctaylor<T, 0>>
+#else
+#define EN_0(FUN, T) nullptr
+#endif
+#if XCFUN_KERNEL_MIN_ORDER <= 1 && XCFUN_KERNEL_MAX_ORDER >= 1
+#define EN_1(FUN, T) FUN<ctaylor<T, 1>>
+#else
+#define EN_1(FUN, T) nullptr
+#endif
+#if XCFUN_KERNEL_MIN_ORDER <= 2 && XCFUN_KERNEL_MAX_ORDER >= 2
+#define EN_2(FUN, T) FUN<ctaylor<T, 2>>
+#else
+#define EN_2(FUN, T) nullptr
+#endif
+#if XCFUN_KERNEL_MIN_ORDER <= 3 && XCFUN_KERNEL_MAX_ORDER >= 3
+#define EN_3(FUN, T) FUN<ctaylor<T, 3>>
+#else
+#define EN_3(FUN, T) nullptr
+#endif
+#if XCFUN_KERNEL_MIN_ORDER <= 4 && XCFUN_KERNEL_MAX_ORDER >= 4
+#define EN_4(FUN, T) FUN<ctaylor<T, 4>>
+#else
+#define EN_4(FUN, T) nullptr
+#endif
+#if XCFUN_KERNEL_MIN_ORDER <= 5 && XCFUN_KERNEL_MAX_ORDER >= 5
+#define EN_5(FUN, T) FUN<ctaylor<T, 5>>
+#else
+#define EN_5(FUN, T) nullptr
+#endif
+#if XCFUN_KERNEL_MIN_ORDER <= 6 && XCFUN_KERNEL_MAX_ORDER >= 6
+#define EN_6(FUN, T) FUN<ctaylor<T, 6>>
+#else
+#define EN_6(FUN, T) nullptr
+#endif
+#if XCFUN_KERNEL_MIN_ORDER <= 7 && XCFUN_KERNEL_MAX_ORDER >= 7
+#define EN_7(FUN, T) FUN<ctaylor<T, 7>>
+#else
+#define EN_7(FUN, T) nullptr
+#endif
+#if XCFUN_KERNEL_MIN_ORDER <= 8 && XCFUN_KERNEL_MAX_ORDER >= 8
+#define EN_8(FUN, T) FUN<ctaylor<T, 8>>
+#else
+#define EN_8(FUN, T) nullptr
+#endif
+#if XCFUN_KERNEL_MIN_ORDER <= 9 && XCFUN_KERNEL_MAX_ORDER >= 9
+#define EN_9(FUN, T) FUN<ctaylor<T, 9>>
+#else
+#define EN_9(FUN, T) nullptr
+#endif
+// The reverse mode kernel for first derivatives goes with those of order 1,
+// the one for Hessian-vector products with those of order 2
+#if XCFUN_KERNEL_MIN_ORDER <= 1 && XCFUN_KERNEL_MAX_ORDER >= 1
+#define EN_ADJOINT1(FUN) FUN<adjoint<ireal_t>>,
+#else
+#define EN_ADJOINT1(FUN) nullptr,
+#endif
+#if XCFUN_KERNEL_MIN_ORDER <= 2 && XCFUN_KERNEL_MAX_ORDER >= 2
+#define EN_ADJOINT2(FUN) FUN<adjoint<ctaylor<ireal_t, 1>>>,
+#else
+#define EN_ADJOINT2(FUN) nullptr,
+#endif
+#define EN_ADJOINT(FUN) EN_ADJOINT1(FUN) EN_ADJOINT2(FUN)
+#define EN(N, FUN) EN_##N(FUN, ireal_t),
+#if defined(XCFUN_CODEGEN)
+// One trace of the template, and the kernel orders of the library
+#define ENERGY_FUNCTION(FUN)                                                        \
+  FUN<codegen::expr>, XCFUN_KERNEL_MIN_ORDER, XCFUN_KERNEL_MAX_ORDER,
+#elif defined(XCFUN_ENABLE_SINGLE)
+#define ENF(N, FUN) EN_##N(FUN, float),
+#define ENERGY_FUNCTION(FUN)                                                        \
+  FOR_EACH(XCFUN_MAX_ORDER, EN, FUN)                                                \
+  FOR_EACH(XCFUN_MAX_ORDER, ENF, FUN) EN_ADJOINT(FUN)
+#else
+#define ENERGY_FUNCTION(FUN) FOR_EACH(XCFUN_MAX_ORDER, EN, FUN) EN_ADJOINT(FUN)
+#endif
 #define PARAMETER(P)                                                                \
-  template <> const char * pardat_db<P>::symbol = #P;                               \
-  template <> parameter_data pardat_db<P>::d
+  template <> const char pardat_db<P>::symbol[] = #P;                               \
+  template <> const parameter_data pardat_db<P>::d
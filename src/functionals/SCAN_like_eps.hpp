@@ -284,14 +284,14 @@ static num SCAN_C(const densvars<num> & d,
 
   num ds_z = ufunc(d.zeta, 5.0 / 3.0) / 2.0;
 
-  num s = sqrt(d.gnn) / (2.0 * pow(3.0 * PI2, 1.0 / 3.0) * pow(d.n, 4.0 / 3.0));
+  num s = sqrt(d.gnn) / (2.0 * pow(3.0 * PI2, 1.0 / 3.0) * d.n_thirds(4));
 
   num tueg_con = 3.0 / 10.0 * pow(3.0 * PI2, 2.0 / 3.0);
   num tueg = 0.0;
   if (IALPHA == 1) {
-    tueg = (tueg_con * pow(d.n, 5.0 / 3.0) + TAU_R) * ds_z;
+    tueg = (tueg_con * d.n_thirds(5) + TAU_R) * ds_z;
   } else {
-    tueg = tueg_con * pow(d.n, 5.0 / 3.0) * ds_z;
+    tueg = tueg_con * d.n_thirds(5) * ds_z;
   }
 
   num tauw = d.gnn / (8.0 * d.n);
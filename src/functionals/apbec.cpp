@@ -30,7 +30,7 @@ template <typename num> static num energy(const densvars<num> & d) {
   num u3 = pow3(u);
   // d2 is t^2
   num d2 = pow(1.0 / 12 * pow(3, 5.0 / 6.0) / pow(M_PI, -1.0 / 6), 2.0) * d.gnn /
-           (u * u * pow(d.n, 7.0 / 3.0));
+           (u * u * d.n_thirds(7));
   num A = bg / expm1(-eps / (param_gamma * u3));
   num d2A = d2 * A;
   num H = param_gamma * u3 * log(1 + bg * d2 * (1 + d2A) / (1 + d2A * (1 + d2A)));
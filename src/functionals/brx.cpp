@@ -86,6 +86,23 @@ static ctaylor<T, Nvar> BR(const ctaylor<T, Nvar> & t) {
   return res;
 }
 
+template <typename T> static adjoint<T> BR(const adjoint<T> & t) {
+  auto tmp = BR_taylor<T, 3>(t.value);
+  return adjoint_unary(t, tmp[0], tmp[1]);
+}
+
+template <typename T>
+static adjoint<ctaylor<T, 1>> BR(const adjoint<ctaylor<T, 1>> & t) {
+  auto tmp = BR_taylor<T, 3>(t.value.c[0]);
+  T c[3] = {tmp[0], tmp[1], tmp[2]};
+  return adjoint_tangent(t, c);
+}
+
+#ifdef XCFUN_CODEGEN
+// The Newton iteration of BR(double) has no expression
+static codegen::expr BR(const codegen::expr & t) { return codegen::untraceable(t); }
+#endif
+
 template <typename num>
 static num polarized(const num & na,
                      const num & gaa,
@@ -22,7 +22,7 @@ template <typename num> static num csc(const densvars<num> & d) {
   num gamma = 2 * (1 - (d.a * d.a + d.b * d.b) / (d.n * d.n));
   num curv = d.a * d.taua + d.b * d.taub - (1.0 / 8.0) * d.gnn - (d.jpaa + d.jpbb);
   return -a * gamma *
-         (d.n + 2 * b * pow(d.n, -5.0 / 3.0) * curv * exp(-c * d.n_m13)) /
+         (d.n + 2 * b * d.n_thirds(-5) * curv * exp(-c * d.n_m13)) /
          (1 + dpar * d.n_m13);
 }
 
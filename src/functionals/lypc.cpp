@@ -21,16 +21,16 @@ template <typename num> static num lypc(const densvars<num> & d) {
   const parameter C = 0.2533;
   const parameter Dd = 0.349;
   using xcfun_constants::CF;
-  num icbrtn = pow(d.n, -1.0 / 3.0);
+  num icbrtn = d.n_m13;
   num P = 1 / (1 + Dd * icbrtn);
-  num omega = exp(-C * icbrtn) * P * pow(d.n, -11.0 / 3.0);
+  num omega = exp(-C * icbrtn) * P * d.n_thirds(-11);
   num delta = icbrtn * (C + Dd * P);
   num n2 = d.n * d.n;
   return -A * (4 * d.a * d.b * P / d.n +
                B * omega *
                    (d.a * d.b *
                         (pow(2, 11.0 / 3.0) * CF *
-                             (pow(d.a, 8.0 / 3.0) + pow(d.b, 8.0 / 3.0)) +
+                             (pow_thirds(d.a)(8) + pow_thirds(d.b)(8)) +
                          (47.0 - 7.0 * delta) * d.gnn / 18.0 -
                          (2.5 - delta / 18.0) * (d.gaa + d.gbb) -
                          (delta - 11.0) / 9.0 * (d.a * d.gaa + d.b * d.gbb) / d.n) -
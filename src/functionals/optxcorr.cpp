@@ -26,8 +26,8 @@ template <typename num> static num optxcorr(const densvars<num> & d) {
   */
 
   const parameter gamma = 0.006;
-  num g_xa2 = gamma * d.gaa * pow(d.a, -8.0 / 3.0);
-  num g_xb2 = gamma * d.gbb * pow(d.b, -8.0 / 3.0);
+  num g_xa2 = gamma * d.gaa * pow_thirds(d.a)(-8);
+  num g_xb2 = gamma * d.gbb * pow_thirds(d.b)(-8);
   return (d.a_43 * (pow(g_xa2, 2) * pow(1 + g_xa2, -2))) +
          (d.b_43 * (pow(g_xb2, 2) * pow(1 + g_xb2, -2)));
 }
@@ -38,17 +38,17 @@ template <typename num> static num Pg(const densvars<num> & d) {
 }
 
 template <typename num> static num dz(const densvars<num> & d) {
-  return cbrt(2.0) * sqrt(pow(d.a, 5.0 / 3.0) + pow(d.b, 5.0 / 3.0)) *
+  return cbrt(2.0) * sqrt(pow_thirds(d.a)(5) + pow_thirds(d.b)(5)) *
          pow(d.n, -5.0 / 6.0);
 }
 
 template <typename num> static num p86c(const densvars<num> & d) {
   return d.n * pz81eps::pz81eps(d) +
-         exp(-Pg(d)) * Cg(d.r_s) * d.gnn / (pow(d.n, 4.0 / 3.0) * dz(d));
+         exp(-Pg(d)) * Cg(d.r_s) * d.gnn / (d.n_thirds(4) * dz(d));
 }
 
 template <typename num> static num p86c_corr(const densvars<num> & d) {
-  return exp(-Pg(d)) * Cg(d.r_s) * d.gnn / (pow(d.n, 4.0 / 3.0) * dz(d));
+  return exp(-Pg(d)) * Cg(d.r_s) * d.gnn / (d.n_thirds(4) * dz(d));
 }
 
 FUNCTIONAL(XC_P86C) = {
@@ -42,7 +42,7 @@ template <typename num> static num pbec(const densvars<num> & d) {
   num u = phi(d);
   // Avoiding the square root of d.gnn here
   num d2 = pow(1.0 / 12 * pow(3, 5.0 / 6.0) / pow(M_PI, -1.0 / 6), 2.0) * d.gnn /
-           (u * u * pow(d.n, 7.0 / 3.0));
+           (u * u * d.n_thirds(7));
   return d.n * (eps + H(d2, eps, pow3(u)));
 }
 
@@ -51,7 +51,7 @@ template <typename num> static num vwn_pbec(const densvars<num> & d) {
   num u = phi(d);
   // Avoiding the square root of d.gnn here
   num d2 = pow(1.0 / 12 * pow(3, 5.0 / 6.0) / pow(M_PI, -1.0 / 6), 2.0) * d.gnn /
-           (u * u * pow(d.n, 7.0 / 3.0));
+           (u * u * d.n_thirds(7));
   return d.n * (eps + H(d2, eps, pow3(u)));
 }
 
@@ -29,7 +29,7 @@ template <typename num> static num energy(const densvars<num> & d) {
   num u3 = pow3(u);
   // d2 is t^2
   num d2 = pow(1.0 / 12 * pow(3, 5.0 / 6.0) / pow(M_PI, -1.0 / 6), 2.0) * d.gnn /
-           (u * u * pow(d.n, 7.0 / 3.0));
+           (u * u * d.n_thirds(7));
   num ff = 1 - exp(-d.r_s * d.r_s);
   num beta = beta0 + aa * d2 * ff;
   num bg = beta / param_gamma;
@@ -20,7 +20,7 @@
 template <typename num> static num tfk(const densvars<num> & d) {
   using xcfun_constants::CF;
 
-  return CF * pow(d.n, 5.0 / 3.0);
+  return CF * d.n_thirds(5);
 }
 
 FUNCTIONAL(XC_TFK) = {"Thomas-Fermi Kinetic Energy Functional",
@@ -32,7 +32,7 @@ template <typename num> static num energy(const densvars<num> & d) {
   num u3 = pow3(u);
   // d2 is t^2
   num d2 = pow(1.0 / 12 * pow(3, 5.0 / 6.0) / pow(M_PI, -1.0 / 6), 2.0) * d.gnn /
-           (u * u * pow(d.n, 7.0 / 3.0));
+           (u * u * d.n_thirds(7));
   num tt = pow(d2, 0.5); // this is t
   num v = tt * u * pow(d.r_s / 3.0, -1.0 / 6.0);
   num v3 = pow3(v);
@@ -0,0 +1,186 @@
+/*
+ * XCFun, an arbitrary order exchange-correlation library
+ * Copyright (C) 2020 Ulf Ekström and contributors.
+ *
+ * This file is part of XCFun.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * For information on the complete list of contributors to the
+ * XCFun library, see: <https://xcfun.readthedocs.io/>
+ */
+
+#include "ldatable.hpp"
+
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "XCFunctional.hpp"
+
+// Box covered by the tables. log(r_s) in [-7,7] is roughly n in
+// [2e-10, 3e8], the cell boundaries fall on integers so that r_s = 1,
+// where some parametrizations switch branches, is never inside a cell.
+#define XC_LDA_TABLE_XMIN -7.0
+#define XC_LDA_TABLE_XMAX 7.0
+#define XC_LDA_TABLE_ZMAX 0.9
+#define XC_LDA_TABLE_MAX_CELLS (1 << 14)
+
+// A table costs about the same for every functional: a log and a tensor
+// Clenshaw sum in the Taylor arithmetic of the kernel. It only pays off
+// for the expensive correlation kernels, from the order at which it was
+// measured faster than the analytic kernel. slaterx, tfk and pz81c are
+// faster analytic at every order.
+int xcint_lda_table_order(int functional_id) {
+  switch (functional_id) {
+    case XC_VWN5C:
+      return 0;
+    case XC_PW92C:
+      return 2;
+    case XC_VWN3C:
+      return 3;
+    default:
+      return -1;
+  }
+}
+
+namespace {
+typedef ctaylor<ireal_t, 0> ttype;
+
+// Energy per particle from the analytic kernel
+double lda_eps(const functional_data & fd, double x, double z) {
+  XCFunctional fun;
+  fun.vars = XC_A_B;
+  double n = 3.0 / (4.0 * M_PI * std::exp(3 * x));
+  ttype in[2];
+  in[0] = 0.5 * n * (1 + z);
+  in[1] = 0.5 * n * (1 - z);
+  densvars<ttype> d(&fun, in);
+  return INNER_TO_OUTER(fd.fp0(d).get(CNST)) / n;
+}
+
+double chebyshev_node(int p) {
+  return std::cos(M_PI * (p + 0.5) / XC_LDA_TABLE_NCOEFF);
+}
+
+// Chebyshev interpolation of eps on the nodes of each cell
+void lda_table_fit(lda_table & tab, const functional_data & fd) {
+  const int NC = XC_LDA_TABLE_NCOEFF;
+  double hx = (tab.xmax - tab.xmin) / tab.nx, hz = (tab.zmax - tab.zmin) / tab.nz;
+  double Tnode[NC][NC];
+  for (int j = 0; j < NC; j++)
+    for (int p = 0; p < NC; p++)
+      Tnode[j][p] = std::cos(j * M_PI * (p + 0.5) / NC);
+  tab.coeffs.assign(tab.nx * tab.nz * NC * NC, 0.0);
+  for (int ix = 0; ix < tab.nx; ix++)
+    for (int iz = 0; iz < tab.nz; iz++) {
+      double f[NC][NC];
+      for (int p = 0; p < NC; p++)
+        for (int q = 0; q < NC; q++)
+          f[p][q] = lda_eps(fd,
+                            tab.xmin + (ix + 0.5 + 0.5 * chebyshev_node(p)) * hx,
+                            tab.zmin + (iz + 0.5 + 0.5 * chebyshev_node(q)) * hz);
+      double * c = &tab.coeffs[(ix * tab.nz + iz) * NC * NC];
+      for (int j = 0; j < NC; j++)
+        for (int k = 0; k < NC; k++) {
+          double sum = 0;
+          for (int p = 0; p < NC; p++)
+            for (int q = 0; q < NC; q++)
+              sum += f[p][q] * Tnode[j][p] * Tnode[k][q];
+          c[j * NC + k] = sum * (j ? 2.0 : 1.0) * (k ? 2.0 : 1.0) / (NC * NC);
+        }
+    }
+}
+
+double lda_table_value(const lda_table & tab, double x, double z) {
+  XCFunctional fun;
+  fun.vars = XC_A_B;
+  double n = 3.0 / (4.0 * M_PI * std::exp(3 * x));
+  ttype in[2];
+  in[0] = 0.5 * n * (1 + z);
+  in[1] = 0.5 * n * (1 - z);
+  densvars<ttype> d(&fun, in);
+  return INNER_TO_OUTER(tab.eval(d).get(CNST)) / n;
+}
+
+// Largest relative error between the nodes, separately for the x and z
+// directions. Probing between the nodes of one direction while sitting
+// on a node of the other isolates the error of each direction.
+void lda_table_error(const lda_table & tab,
+                     const functional_data & fd,
+                     double & xerr,
+                     double & zerr) {
+  const int NC = XC_LDA_TABLE_NCOEFF;
+  double hx = (tab.xmax - tab.xmin) / tab.nx, hz = (tab.zmax - tab.zmin) / tab.nz;
+  xerr = 0;
+  zerr = 0;
+  for (int ix = 0; ix < tab.nx; ix++)
+    for (int iz = 0; iz < tab.nz; iz++)
+      for (int p = 0; p <= NC; p++) {
+        // Extrema of T_NC lie between the nodes, pulled slightly inside
+        // the cell so that the probe is evaluated with this cell
+        double mid = 0.999 * std::cos(M_PI * p / NC);
+        for (int q = 0; q < NC; q++) {
+          double node = chebyshev_node(q);
+          double x = tab.xmin + (ix + 0.5 + 0.5 * mid) * hx;
+          double z = tab.zmin + (iz + 0.5 + 0.5 * node) * hz;
+          double ref = lda_eps(fd, x, z);
+          double err = std::abs(lda_table_value(tab, x, z) - ref) / std::abs(ref);
+          if (err > xerr)
+            xerr = err;
+          x = tab.xmin + (ix + 0.5 + 0.5 * node) * hx;
+          z = tab.zmin + (iz + 0.5 + 0.5 * mid) * hz;
+          ref = lda_eps(fd, x, z);
+          err = std::abs(lda_table_value(tab, x, z) - ref) / std::abs(ref);
+          if (err > zerr)
+            zerr = err;
+        }
+      }
+}
+
+std::shared_ptr<const lda_table> lda_table_build(int functional_id,
+                                                 double tolerance) {
+  const functional_data & fd = *xcint_funs[functional_id];
+  std::shared_ptr<lda_table> tab(new lda_table);
+  tab->xmin = XC_LDA_TABLE_XMIN;
+  tab->xmax = XC_LDA_TABLE_XMAX;
+  tab->zmin = -XC_LDA_TABLE_ZMAX;
+  tab->zmax = XC_LDA_TABLE_ZMAX;
+  tab->nx = static_cast<int>(XC_LDA_TABLE_XMAX - XC_LDA_TABLE_XMIN);
+  tab->nz = 2;
+  tab->min_order = xcint_lda_table_order(functional_id);
+  for (;;) {
+    lda_table_fit(*tab, fd);
+    double xerr, zerr;
+    lda_table_error(*tab, fd, xerr, zerr);
+    if (!(xerr > tolerance) && !(zerr > tolerance))
+      return tab;
+    if (2 * tab->nx * tab->nz > XC_LDA_TABLE_MAX_CELLS)
+      return nullptr;
+    if (xerr > tolerance)
+      tab->nx *= 2;
+    if (zerr > tolerance && 2 * tab->nx * tab->nz <= XC_LDA_TABLE_MAX_CELLS)
+      tab->nz *= 2;
+  }
+}
+} // namespace
+
+std::shared_ptr<const lda_table> xcint_lda_table(int functional_id,
+                                                 double tolerance) {
+  if (xcint_lda_table_order(functional_id) < 0 || !(tolerance > 0) ||
+      !xcint_has_kernel(*xcint_funs[functional_id], 0))
+    return nullptr;
+  static std::mutex lock;
+  static std::map<std::pair<int, double>, std::shared_ptr<const lda_table>> cache;
+  std::lock_guard<std::mutex> guard(lock);
+  auto key = std::make_pair(functional_id, tolerance);
+  auto it = cache.find(key);
+  if (it != cache.end())
+    return it->second;
+  auto tab = lda_table_build(functional_id, tolerance);
+  cache[key] = tab;
+  return tab;
+}
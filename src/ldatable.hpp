@@ -0,0 +1,100 @@
+/*
+ * XCFun, an arbitrary order exchange-correlation library
+ * Copyright (C) 2020 Ulf Ekström and contributors.
+ *
+ * This file is part of XCFun.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * For information on the complete list of contributors to the
+ * XCFun library, see: <https://xcfun.readthedocs.io/>
+ */
+
+#pragma once
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "config.hpp"
+#include "xcint.hpp"
+
+// Degree of the Chebyshev expansion in each direction of a table cell
+#define XC_LDA_TABLE_DEGREE 7
+#define XC_LDA_TABLE_NCOEFF (XC_LDA_TABLE_DEGREE + 1)
+
+template <typename T> static double xcint_cnst(const T & x) {
+  return INNER_TO_OUTER(x);
+}
+
+template <typename T, int N> static double xcint_cnst(const ctaylor<T, N> & x) {
+  return INNER_TO_OUTER(x.get(CNST));
+}
+
+/*
+  Interpolation table for the energy per particle eps(r_s, zeta) = E/n
+  of a functional depending only on the density. The table covers a
+  box in (log r_s, zeta), split into nx*nz equal cells. Each cell holds
+  a tensor Chebyshev expansion, which is evaluated with the same number
+  type as the analytic kernel. The derivatives of any order are those of
+  the interpolant, which converge with the values for these smooth
+  functions. Points outside the box are not covered, the caller must
+  use the analytic kernel for those and for orders below min_order.
+ */
+struct lda_table {
+  double xmin, xmax; // log(r_s)
+  double zmin, zmax; // zeta
+  int nx, nz;
+  int min_order; // Taylor order from which eval() beats the kernel
+  std::vector<double> coeffs; // nx*nz cells, each NCOEFF*NCOEFF
+
+  template <typename T> bool covers(const densvars<T> & d) const {
+    double x = std::log(xcint_cnst(d.r_s));
+    double z = xcint_cnst(d.zeta);
+    return x > xmin && x < xmax && z > zmin && z < zmax;
+  }
+
+  template <typename T> T eval(const densvars<T> & d) const {
+    const int NC = XC_LDA_TABLE_NCOEFF;
+    double hx = (xmax - xmin) / nx, hz = (zmax - zmin) / nz;
+    T x = log(d.r_s);
+    int ix = static_cast<int>((xcint_cnst(x) - xmin) / hx);
+    int iz = static_cast<int>((xcint_cnst(d.zeta) - zmin) / hz);
+    ix = ix < 0 ? 0 : (ix >= nx ? nx - 1 : ix);
+    iz = iz < 0 ? 0 : (iz >= nz ? nz - 1 : iz);
+    // Map the cell onto [-1,1]^2
+    T u = (2 / hx) * (x - (xmin + (ix + 0.5) * hx));
+    T v = (2 / hz) * (d.zeta - (zmin + (iz + 0.5) * hz));
+    const double * c = &coeffs[(ix * nz + iz) * NC * NC];
+    T tv[NC];
+    tv[0] = 1;
+    tv[1] = v;
+    for (int k = 2; k < NC; k++)
+      tv[k] = 2 * v * tv[k - 1] - tv[k - 2];
+    // Clenshaw recurrence in u, each row contracted with T_k(v)
+    T b1 = 0, b2 = 0;
+    for (int j = NC - 1; j >= 1; j--) {
+      T b0 = 2 * u * b1 - b2;
+      for (int k = 0; k < NC; k++)
+        b0 += c[j * NC + k] * tv[k];
+      b2 = b1;
+      b1 = b0;
+    }
+    T eps = u * b1 - b2;
+    for (int k = 0; k < NC; k++)
+      eps += c[k] * tv[k];
+    return d.n * eps;
+  }
+};
+
+// Lowest Taylor order at which the table of a functional that only
+// depends on (n, zeta) is used, -1 if it is never tabulated
+int xcint_lda_table_order(int functional_id);
+
+// Table for the functional with relative error below tolerance, or
+// nullptr if the functional cannot be tabulated to this accuracy.
+// Tables are built once and shared between functional objects.
+std::shared_ptr<const lda_table> xcint_lda_table(int functional_id,
+                                                 double tolerance);
@@ -25,19 +25,76 @@
 #include <strings.h>
 #endif
 
-functional_data xcint_funs[XC_NR_FUNCTIONALS];
-parameter_data xcint_params[XC_NR_PARAMETERS_AND_FUNCTIONALS];
+// Lists of ids, from which the tables are built as constants. Nothing is
+// copied at run time, see xcint_assure_setup().
+template <int... I> struct xcint_ids {};
+
+template <int BEGIN, int END, int... I>
+struct xcint_range : xcint_range<BEGIN, END - 1, END - 1, I...> {};
+
+template <int BEGIN, int... I> struct xcint_range<BEGIN, BEGIN, I...> {
+  typedef xcint_ids<I...> type;
+};
+
+typedef xcint_range<0, XC_NR_FUNCTIONALS>::type xcint_functional_ids;
+typedef xcint_range<XC_NR_FUNCTIONALS, XC_NR_PARAMETERS_AND_FUNCTIONALS>::type
+    xcint_parameter_ids;
+
+template <int... F>
+constexpr std::array<const functional_data *, XC_NR_FUNCTIONALS> xcint_fun_table(
+    xcint_ids<F...>) {
+  return {{&fundat_db<F>::d.data...}};
+}
+
+template <int... F>
+constexpr std::array<const functional_description *, XC_NR_FUNCTIONALS>
+xcint_description_table(xcint_ids<F...>) {
+  return {{&fundat_db<F>::d.description...}};
+}
+
+template <int... F>
+constexpr std::array<const functional_test *, XC_NR_FUNCTIONALS> xcint_test_table(
+    xcint_ids<F...>) {
+  return {{&fundat_db<F>::d.test...}};
+}
+
+template <int... F, int... P>
+constexpr std::array<const char *, XC_NR_PARAMETERS_AND_FUNCTIONALS>
+xcint_name_table(xcint_ids<F...>, xcint_ids<P...>) {
+  return {{(fundat_db<F>::symbol + 3)..., (pardat_db<P>::symbol + 3)...}};
+}
+
+template <int> constexpr const parameter_data * xcint_no_parameter() {
+  return nullptr;
+}
+
+template <int... F, int... P>
+constexpr std::array<const parameter_data *, XC_NR_PARAMETERS_AND_FUNCTIONALS>
+xcint_param_table(xcint_ids<F...>, xcint_ids<P...>) {
+  return {{xcint_no_parameter<F>()..., &pardat_db<P>::d...}};
+}
+
+std::array<const functional_data *, XC_NR_FUNCTIONALS> xcint_funs =
+    xcint_fun_table(xcint_functional_ids());
+const std::array<const functional_description *, XC_NR_FUNCTIONALS>
+    xcint_descriptions = xcint_description_table(xcint_functional_ids());
+const std::array<const functional_test *, XC_NR_FUNCTIONALS> xcint_tests =
+    xcint_test_table(xcint_functional_ids());
+const std::array<const char *, XC_NR_PARAMETERS_AND_FUNCTIONALS> xcint_names =
+    xcint_name_table(xcint_functional_ids(), xcint_parameter_ids());
+const std::array<const parameter_data *, XC_NR_PARAMETERS_AND_FUNCTIONALS>
+    xcint_params = xcint_param_table(xcint_functional_ids(), xcint_parameter_ids());
 
 int xcint_lookup_functional(const char * name) {
   for (int i = 0; i < XC_NR_FUNCTIONALS; i++)
-    if (strcasecmp(name, xcint_funs[i].name) == 0)
+    if (strcasecmp(name, xcint_names[i]) == 0)
       return i;
   return -1;
 }
 
 int xcint_lookup_parameter(const char * name) {
   for (int i = XC_NR_FUNCTIONALS; i < XC_NR_PARAMETERS_AND_FUNCTIONALS; i++)
-    if (strcasecmp(name, xcint_params[i].name) == 0)
+    if (strcasecmp(name, xcint_names[i]) == 0)
       return i;
   return -1;
 }
@@ -49,48 +106,35 @@ int xcint_lookup_alias(const char * name) {
   return -1;
 }
 
-template <int FUN> void xcint_functional_setup_helper() {
-  if (!(fundat_db<FUN>::symbol[0] == 'X' && fundat_db<FUN>::symbol[1] == 'C' &&
-        fundat_db<FUN>::symbol[2] == '_'))
-    xcfun::die("Functional symbol does not start with XC_", FUN);
-  fundat_db<FUN>::d.name = fundat_db<FUN>::symbol + 3;
-  fundat_db<FUN>::d.id = static_cast<xcfun_functional_id>(FUN);
-  xcint_funs[FUN] = fundat_db<FUN>::d;
-  xcint_functional_setup_helper<FUN + 1>();
-}
-
-template <> void xcint_functional_setup_helper<XC_NR_FUNCTIONALS>() {}
-
-template <int FUN, int SPAN> struct retarded_helper {
-  static void doit() {
-    retarded_helper<FUN, SPAN / 2>::doit();
-    retarded_helper<FUN + SPAN / 2, (SPAN + 1) / 2>::doit();
-  }
-};
-
-template <int FUN> struct retarded_helper<FUN, 1> {
-  static void doit() {
-    if (!(fundat_db<FUN>::symbol[0] == 'X' && fundat_db<FUN>::symbol[1] == 'C' &&
-          fundat_db<FUN>::symbol[2] == '_'))
-      xcfun::die("Functional symbol does not start with XC_", FUN);
-    fundat_db<FUN>::d.name = fundat_db<FUN>::symbol + 3;
-    fundat_db<FUN>::d.id = static_cast<xcfun_functional_id>(FUN);
-    xcint_funs[FUN] = fundat_db<FUN>::d;
+bool xcint_has_kernel(const functional_data & fd, int order) {
+  switch (order) {
+#define HAS_FP(N, E)                                                                \
+  case N:                                                                           \
+    return static_cast<bool>(fd.fp##N);
+    FOR_EACH(XCFUN_MAX_ORDER, HAS_FP, )
+    default:
+      return false;
   }
-};
+}
 
-template <int P> void xcint_parameter_setup_helper() {
-  if (!(pardat_db<P>::symbol[0] == 'X' && pardat_db<P>::symbol[1] == 'C' &&
-        pardat_db<P>::symbol[2] == '_'))
-    xcfun::die("Symbol does not start with XC_", P);
-  pardat_db<P>::d.name = pardat_db<P>::symbol + 3;
-  xcint_params[P] = pardat_db<P>::d;
-  xcint_parameter_setup_helper<P + 1>();
+bool xcint_is_compiled(const functional_data & fd) {
+  for (int i = 0; i <= XCFUN_MAX_ORDER; i++)
+    if (xcint_has_kernel(fd, i))
+      return true;
+  return false;
 }
 
-template <> void xcint_parameter_setup_helper<XC_NR_PARAMETERS_AND_FUNCTIONALS>() {}
+#ifndef XCFUN_ENABLE_CODEGEN
+// Without generated kernels, see tools/codegen
+xcint_generated_fn xcint_generated_kernel(int, xcfun_vars, int) { return nullptr; }
+#endif
+
+#ifndef XCFUN_ENABLE_JIT
+// Without run time compiled kernels, see xcint_jit.cpp
+xcint_generated_fn xcint_jit_kernel(const XCFunctional *) { return nullptr; }
+#endif
 
-vars_data xcint_vars[XC_NR_VARS] = {
+const vars_data xcint_vars[XC_NR_VARS] = {
     {"XC_A", 1, XC_DENSITY},
     {"XC_N", 1, XC_DENSITY},
     {"XC_A_B", 2, XC_DENSITY},
@@ -134,18 +178,29 @@ vars_data xcint_vars[XC_NR_VARS] = {
     {"XC_N_S_2ND_TAYLOR", 20, XC_DENSITY | XC_GRADIENT | XC_LAPLACIAN},
 };
 
-void xcint_assure_setup() {
-  static bool is_setup = false;
-  if (!is_setup) {
-    retarded_helper<0, XC_NR_FUNCTIONALS>::doit();
-    //      xcint_functional_setup_helper<0>();
-    xcint_parameter_setup_helper<XC_NR_FUNCTIONALS>();
+bool xcint_densvars_supported(xcfun_vars vars) {
+  double d[XC_MAX_INVARS] = {0};
+  densvars<double> v(nullptr);
+  return v.unpack(vars, d);
+}
+
+static bool xcint_setup() {
+  xcint_isa_setup();
 #ifndef NDEBUG
-    /* Verify that the variable definition is consistent. */
-    for (int i = 0; i < XC_NR_VARS; i++) {
-      assert(xcint_vars[i].len <= XC_MAX_INVARS);
-    }
-#endif
-    is_setup = true;
+  /* Verify that the variable definition is consistent. */
+  for (int i = 0; i < XC_NR_VARS; i++) {
+    assert(xcint_vars[i].len <= XC_MAX_INVARS);
   }
+  /* The names are symbols after their XC_ */
+  for (int i = 0; i < XC_NR_PARAMETERS_AND_FUNCTIONALS; i++)
+    assert(strncmp(xcint_names[i] - 3, "XC_", 3) == 0);
+#endif
+  return true;
+}
+
+void xcint_assure_setup() {
+  // xcint_isa_setup() rewrites xcint_funs, the initialization of a local
+  // static runs it once even if several threads create functionals
+  static bool is_setup = xcint_setup();
+  (void)is_setup;
 }
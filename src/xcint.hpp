@@ -16,9 +16,12 @@
 
 #include <array>
 #include <cstdio>
-#include <functional>
 
+#include "adjoint.hpp"
 #include "config.hpp"
+#ifdef XCFUN_CODEGEN
+#include "trace.hpp"
+#endif
 #include "ctaylor.hpp"
 #include "densvars.hpp"
 #include "taylor.hpp"
@@ -47,28 +50,52 @@
 #define XC_KINETIC 8
 #define XC_JP 16
 
-struct functional_data {
+// Descriptions of one functional, only read by the queries of the API
+struct functional_description {
   const char * short_description;
   const char * long_description;
+};
+
+// The kernels of one functional, all evaluation reads. Only plain data, so
+// that the tables of xcint.cpp are constant initialized.
+struct functional_data {
   int depends; // XC_DENSITY | XC_GRADIENT etc
 #define FP(N, E)                                                                    \
-  std::function<ctaylor<ireal_t, N>(const densvars<ctaylor<ireal_t, N>> &)> fp##N;
+  ctaylor<ireal_t, N> (*fp##N)(const densvars<ctaylor<ireal_t, N>> &);
   FOR_EACH(XCFUN_MAX_ORDER, FP, )
+#ifdef XCFUN_ENABLE_SINGLE
+  // Single precision kernels, see xcfun_set_single_precision()
+#define FPF(N, E) ctaylor<float, N> (*fpf##N)(const densvars<ctaylor<float, N>> &);
+  FOR_EACH(XCFUN_MAX_ORDER, FPF, )
+#endif
+  // Gradient by reverse mode, see xcint_eval_adjoint(), and Hessian times a
+  // direction by forward over reverse mode
+  adjoint<ireal_t> (*fpa)(const densvars<adjoint<ireal_t>> &);
+  adjoint<ctaylor<ireal_t, 1>> (*fphv)(
+      const densvars<adjoint<ctaylor<ireal_t, 1>>> &);
+};
+
+// Reference values of one functional, only read by xcfun_test()
+struct functional_test {
   xcfun_vars test_vars;
   xcfun_mode test_mode;
   int test_order;
   double test_threshold;
   std::array<double, 16> test_in; // Increase dimensions if future tests require it
   std::array<double, 128> test_out;
-  xcfun_functional_id id;
-  const char * name; // Set up automatically from the symbol
+};
+
+// What FUNCTIONAL defines. The initializers in src/functionals list the
+// fields of all three in order, functionals without a test leave it zero.
+struct functional_definition {
+  functional_description description;
+  functional_data data;
+  functional_test test;
 };
 
 struct parameter_data {
   const char * description;
   parameter default_value;
-
-  const char * name; // Set up automatically
 };
 
 struct vars_data {
@@ -86,9 +113,20 @@ struct alias_data {
   } terms[MAX_ALIAS_TERMS];
 };
 
-extern functional_data xcint_funs[XC_NR_FUNCTIONALS];
-extern parameter_data xcint_params[XC_NR_PARAMETERS_AND_FUNCTIONALS];
-extern vars_data xcint_vars[XC_NR_VARS];
+// Constant initialized from the definitions in src/functionals, indexed by
+// functional or parameter id. Only xcint_isa_setup() changes xcint_funs.
+extern std::array<const functional_data *, XC_NR_FUNCTIONALS> xcint_funs;
+extern const std::array<const functional_description *, XC_NR_FUNCTIONALS>
+    xcint_descriptions;
+extern const std::array<const functional_test *, XC_NR_FUNCTIONALS> xcint_tests;
+extern const std::array<const char *, XC_NR_PARAMETERS_AND_FUNCTIONALS>
+    xcint_names; // Symbols without XC_
+extern const std::array<const parameter_data *, XC_NR_PARAMETERS_AND_FUNCTIONALS>
+    xcint_params; // Null for the functionals
+extern const vars_data xcint_vars[XC_NR_VARS];
+// True if densvars unpacks vars. xcfun_eval_setup refuses the others, so
+// that evaluation never fails.
+bool xcint_densvars_supported(xcfun_vars vars);
 extern alias_data * xcint_aliases;
 
 void xcint_assure_setup();
@@ -101,13 +139,88 @@ int xcint_lookup_functional(const char * name);
 int xcint_lookup_parameter(const char * name);
 int xcint_lookup_alias(const char * name);
 
+// Kernels left out by a selective build (XCFUN_FUNCTIONALS and the order
+// ranges in cmake/custom/xcfun.cmake) are empty
+bool xcint_has_kernel(const functional_data & fd, int order);
+bool xcint_is_compiled(const functional_data & fd);
+
 // This gets filled in by the functional implementations
 template <int FUN> struct fundat_db {
+  static const char symbol[];
+  static const functional_definition d;
+};
+
+#ifdef XCFUN_ISA
+// Kernels compiled for one instruction set, see xcint_isa.cpp. Only plain
+// data, so that loading the library never runs code for an instruction
+// set the CPU may not have.
+template <int FUN> struct isa_fundat_db {
+  static const functional_definition d;
+};
+#endif
+
+#ifdef XCFUN_CODEGEN
+// The functionals as seen by the kernel generator in tools/codegen, which
+// compiles them once more with XCFUN_CODEGEN set. The initializers follow
+// functional_definition.
+struct codegen_functional_data {
+  const char * short_description;
+  const char * long_description;
+  int depends;
+  codegen::expr (*fp)(const densvars<codegen::expr> &);
+  int min_order, max_order; // Kernel orders compiled into the library
+  xcfun_vars test_vars;
+  xcfun_mode test_mode;
+  int test_order;
+  double test_threshold;
+  std::array<double, 16> test_in;
+  std::array<double, 128> test_out;
+};
+
+template <int FUN> struct codegen_fundat_db {
   static const char * symbol;
-  static functional_data d;
+  static const codegen_functional_data d;
 };
 
+// Parameters are read at run time, so that kernels reading them cannot be
+// generated at build time
+template <>
+inline double densvars<codegen::expr>::get_param(enum xc_parameter p) const {
+  if (!codegen::active()->fixed_parameters)
+    codegen::active()->parametric = true;
+  return parent->settings[p];
+}
+#endif
+
+// Straight-line kernels from tools/codegen for partial derivatives of
+// one functional, vars and order, null if there is none. See
+// xcint_generated_fn and xcfun_set_generated_kernels().
+xcint_generated_fn xcint_generated_kernel(int functional_id,
+                                          xcfun_vars vars,
+                                          int order);
+
+// Straight-line kernel of the whole mixture of fun for its current setup,
+// with the weights and parameters as constants, compiled at run time and
+// cached on disk. Null if it cannot be traced or compiled. See
+// xcint_jit.cpp and xcfun_set_jit().
+xcint_generated_fn xcint_jit_kernel(const XCFunctional * fun);
+
+// Bounds of the generated and run time compiled kernels, whose outputs go
+// through a buffer of this size in xcint_eval_generated(). emit.cpp checks
+// CODEGEN_MAX_ORDER and codegen_vars against them.
+#define XCINT_GENERATED_MAX_ORDER 2
+#define XCINT_GENERATED_MAX_INVARS 7
+
+// Number of partial derivatives of n variables up to order k, as taylorlen()
+constexpr int xcint_taylorlen(int n, int k) {
+  return k == 0 ? 1 : xcint_taylorlen(n, k - 1) * (n + k) / k;
+}
+
+// Replace the kernels in xcint_funs by the best ones for this CPU
+void xcint_isa_setup();
+const char * xcint_isa_name();
+
 template <int FUN> struct pardat_db {
-  static const char * symbol;
-  static parameter_data d;
+  static const char symbol[];
+  static const parameter_data d;
 };
@@ -0,0 +1,101 @@
+/*
+ * XCFun, an arbitrary order exchange-correlation library
+ * Copyright (C) 2020 Ulf Ekström and contributors.
+ *
+ * This file is part of XCFun.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * For information on the complete list of contributors to the
+ * XCFun library, see: <https://xcfun.readthedocs.io/>
+ */
+
+/*
+  Run time selection of the functional kernels. With
+  XCFUN_ENABLE_ISA_DISPATCH the functionals are compiled once more for
+  each instruction set in src/CMakeLists.txt, together with this file and
+  XCFUN_ISA set. Each of these builds is linked into a single object in
+  which only xcint_isa_setup_<ISA> stays global, so the copies of inline
+  and template code cannot mix between instruction sets.
+ */
+
+#include "xcint.hpp"
+
+#ifdef XCFUN_ISA
+
+#define XCINT_ISA_ENTRY2(ISA) xcint_isa_setup_##ISA
+#define XCINT_ISA_ENTRY(ISA) XCINT_ISA_ENTRY2(ISA)
+
+template <int FUN, int SPAN> struct isa_helper {
+  static void doit(const functional_data * funs[]) {
+    isa_helper<FUN, SPAN / 2>::doit(funs);
+    isa_helper<FUN + SPAN / 2, (SPAN + 1) / 2>::doit(funs);
+  }
+};
+
+template <int FUN> struct isa_helper<FUN, 1> {
+  static void doit(const functional_data * funs[]) {
+    funs[FUN] = &isa_fundat_db<FUN>::d.data;
+  }
+};
+
+extern "C" void XCINT_ISA_ENTRY(XCFUN_ISA)(const functional_data * funs[]);
+
+extern "C" void XCINT_ISA_ENTRY(XCFUN_ISA)(const functional_data * funs[]) {
+  isa_helper<0, XC_NR_FUNCTIONALS>::doit(funs);
+}
+
+#else
+
+#include <cstdlib>
+#include <cstring>
+
+static const char * xcint_isa = "generic";
+
+#ifdef XCFUN_ISA_DISPATCH
+extern "C" void xcint_isa_setup_avx512(const functional_data * funs[]);
+extern "C" void xcint_isa_setup_avx2(const functional_data * funs[]);
+extern "C" void xcint_isa_setup_sse42(const functional_data * funs[]);
+
+struct isa_kernels {
+  const char * name;
+  bool supported;
+  void (*setup)(const functional_data * funs[]);
+};
+#endif
+
+void xcint_isa_setup() {
+#ifdef XCFUN_ISA_DISPATCH
+  __builtin_cpu_init();
+  // Best first. The environment variable XCFUN_ISA selects one by name, or
+  // the generic kernels if it names something this CPU cannot run.
+  isa_kernels isas[] = {
+      {"avx512",
+       __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") &&
+           __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl"),
+       xcint_isa_setup_avx512},
+      {"avx2",
+       __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"),
+       xcint_isa_setup_avx2},
+      {"sse4.2",
+       __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"),
+       xcint_isa_setup_sse42},
+  };
+  const char * request = getenv("XCFUN_ISA");
+  if (request && !request[0])
+    request = nullptr;
+  for (auto & isa : isas) {
+    if (!isa.supported || (request && strcmp(request, isa.name) != 0))
+      continue;
+    isa.setup(xcint_funs.data());
+    xcint_isa = isa.name;
+    return;
+  }
+#endif
+}
+
+const char * xcint_isa_name() { return xcint_isa; }
+
+#endif
@@ -0,0 +1,210 @@
+/*
+ * XCFun, an arbitrary order exchange-correlation library
+ * Copyright (C) 2020 Ulf Ekström and contributors.
+ *
+ * This file is part of XCFun.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * For information on the complete list of contributors to the
+ * XCFun library, see: <https://xcfun.readthedocs.io/>
+ */
+
+/*
+  Kernels compiled at run time for one mixture of functionals, with
+  XCFUN_ENABLE_JIT. This file and the functionals are compiled once more
+  with XCFUN_CODEGEN in src/CMakeLists.txt, as for tools/codegen. The sum
+  of the active functionals is traced with their weights and parameters as
+  constants, the partial derivatives are written out by emit.hpp and the
+  source is compiled into a shared object with the C++ compiler of the
+  build, which is then loaded with dlopen.
+
+  The kernels include expand.hpp and the Taylor headers it needs, which
+  are installed to include/XCFun/jit. Before installation the copies in the
+  build tree are used.
+
+  The shared objects are kept in a cache directory, named by a hash of
+  everything the kernel depends on: the library version, a hash of the
+  functional and code generator sources taken at configure time, the
+  compiler command, the vars, mode and order, and all weights and
+  parameters. Later setups, also in other processes, load them without
+  tracing or compiling. The environment variables
+
+    XCFUN_JIT_CACHE    cache directory, by default $XDG_CACHE_HOME/xcfun or
+                       $HOME/.cache/xcfun
+    XCFUN_JIT_CXX      compiler, by default the one the library was built with
+    XCFUN_JIT_FLAGS    optimization flags, by default -O2
+    XCFUN_JIT_INCLUDE  directory of expand.hpp, by default the installed one
+
+  override the defaults. Failures leave the Taylor kernels in use.
+*/
+
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "emit.hpp"
+
+#ifdef TAYLOR_VMATH
+#define XCFUN_JIT_DEFINES " -DTAYLOR_VMATH"
+#else
+#define XCFUN_JIT_DEFINES ""
+#endif
+
+static std::string jit_getenv(const char * name, const std::string & fallback) {
+  const char * v = std::getenv(name);
+  return v && v[0] ? std::string(v) : fallback;
+}
+
+static std::string jit_cache_dir() {
+  std::string home = jit_getenv("HOME", "");
+  std::string cache =
+      jit_getenv("XDG_CACHE_HOME", home.empty() ? "" : home + "/.cache");
+  return jit_getenv("XCFUN_JIT_CACHE", cache.empty() ? "" : cache + "/xcfun");
+}
+
+// The installed headers of the kernels, or those of the build tree
+static std::string jit_include_dir() {
+  struct stat st;
+  bool installed = stat(XCFUN_JIT_INCLUDE_DIR "/expand.hpp", &st) == 0;
+  return jit_getenv("XCFUN_JIT_INCLUDE",
+                    installed ? XCFUN_JIT_INCLUDE_DIR : XCFUN_JIT_BUILD_INCLUDE_DIR);
+}
+
+// Creates dir and its parents, true if it exists afterwards
+static bool jit_make_dirs(const std::string & dir) {
+  for (size_t i = 1; i <= dir.size(); i++)
+    if (i == dir.size() || dir[i] == '/')
+      if (mkdir(dir.substr(0, i).c_str(), 0755) != 0 && errno != EEXIST)
+        return false;
+  struct stat st;
+  return stat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// FNV-1a
+static void jit_hash(uint64_t & h, const void * data, size_t n) {
+  const unsigned char * p = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < n; i++) {
+    h ^= p[i];
+    h *= 1099511628211ull;
+  }
+}
+
+static void jit_hash(uint64_t & h, const std::string & s) {
+  jit_hash(h, s.c_str(), s.size() + 1);
+}
+
+static xcint_generated_fn jit_load(const std::string & path) {
+  void * lib = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (!lib)
+    return nullptr;
+  // The library stays loaded, other functionals may use the kernel
+  return reinterpret_cast<xcint_generated_fn>(dlsym(lib, "xcfun_jit_kernel"));
+}
+
+// Traces the mixture and writes the kernel source to path. False if the
+// mixture cannot be traced.
+static bool jit_write_source(const XCFunctional * fun, const std::string & path) {
+  int inlen = xcint_vars[fun->vars].len;
+  codegen::graph g;
+  g.fixed_parameters = true;
+  codegen::active() = &g;
+  codegen::expr in[XC_MAX_INVARS];
+  for (int i = 0; i < inlen; i++)
+    in[i] = codegen::expr::node(g.input(i));
+  densvars<codegen::expr> d(fun, in);
+  codegen::expr y = 0;
+  for (int i = 0; i < fun->nr_active_functionals; i++) {
+    int id = fun->active_ids[i];
+    y += fun->active_terms[i].weight * codegen_funs[id]->fp(d);
+  }
+  codegen::active() = nullptr;
+  if (g.branched || g.singular)
+    return false;
+  std::FILE * f = std::fopen(path.c_str(), "w");
+  if (!f)
+    return false;
+  std::fprintf(f, "// Generated by xcfun_set_jit for");
+  for (int i = 0; i < fun->nr_active_functionals; i++) {
+    std::fprintf(f,
+                 " %.17g %s",
+                 fun->active_terms[i].weight,
+                 codegen_symbols[fun->active_ids[i]] + 3);
+  }
+  std::fprintf(f,
+               ", do not edit\n\n#include \"expand.hpp\"\n\n"
+               "extern \"C\" void xcfun_jit_kernel(double w, const double d[], "
+               "double out[]);\n");
+  std::vector<int> out = codegen::partial_derivatives(g, y.id, inlen, fun->order);
+  bool ok = codegen::emit_kernel(f, g, "xcfun_jit_kernel", out);
+  return std::fclose(f) == 0 && ok;
+}
+
+xcint_generated_fn xcint_jit_kernel(const XCFunctional * fun) {
+  static std::mutex lock;
+  static std::map<uint64_t, xcint_generated_fn> loaded;
+  if (fun->mode != XC_PARTIAL_DERIVATIVES || fun->order > CODEGEN_MAX_ORDER)
+    return nullptr;
+  bool supported = false;
+  for (const auto & v : codegen_vars)
+    supported = supported || v.vars == fun->vars;
+  if (!supported)
+    return nullptr;
+  std::string dir = jit_cache_dir();
+  if (dir.empty())
+    return nullptr;
+  std::string command = "\"" + jit_getenv("XCFUN_JIT_CXX", XCFUN_JIT_CXX) +
+                        "\" -std=c++11 -shared -fPIC " +
+                        jit_getenv("XCFUN_JIT_FLAGS", "-O2") + XCFUN_JIT_DEFINES +
+                        " -I\"" + jit_include_dir() + "\"";
+  uint64_t h = 14695981039346656037ull;
+  jit_hash(h, xcfun_version());
+  jit_hash(h, XCFUN_JIT_SOURCE_HASH);
+  jit_hash(h, command);
+  jit_hash(h, &fun->vars, sizeof(fun->vars));
+  jit_hash(h, &fun->mode, sizeof(fun->mode));
+  jit_hash(h, &fun->order, sizeof(fun->order));
+  for (int i = 0; i < fun->nr_active_functionals; i++)
+    jit_hash(h, &fun->active_ids[i], sizeof(xcfun_functional_id));
+  jit_hash(h, fun->settings.data(), sizeof(fun->settings));
+
+  // Tracing uses the global graph of codegen::active()
+  std::lock_guard<std::mutex> guard(lock);
+  auto known = loaded.find(h);
+  if (known != loaded.end())
+    return known->second;
+  char name[32];
+  std::snprintf(name, sizeof(name), "xcfun-jit-%016llx", (unsigned long long)h);
+  std::string base = dir + "/" + name;
+  xcint_generated_fn kernel = jit_load(base + ".so");
+  if (!kernel && jit_make_dirs(dir)) {
+    codegen_setup_functionals();
+    // Other processes may compile the same kernel, each renames its own
+    std::string tmp = base + "." + std::to_string(getpid());
+    if (jit_write_source(fun, tmp + ".cpp") &&
+        std::system((command + " -o \"" + tmp + ".so\" \"" + tmp + ".cpp\" > \"" +
+                     base + ".log\" 2>&1")
+                        .c_str()) == 0 &&
+        std::rename((tmp + ".so").c_str(), (base + ".so").c_str()) == 0) {
+      std::rename((tmp + ".cpp").c_str(), (base + ".cpp").c_str());
+      std::remove((base + ".log").c_str());
+      kernel = jit_load(base + ".so");
+    }
+    std::remove((tmp + ".cpp").c_str());
+    std::remove((tmp + ".so").c_str());
+  }
+  loaded[h] = kernel;
+  return kernel;
+}
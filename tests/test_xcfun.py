@@ -386,3 +386,238 @@ def test_raises_eval_potential_ab(lda_fun, pbe_fun):
         pbe_fun.eval_potential_ab(numpy.zeros((10, 2)), numpy.zeros((10, 3, 2)), numpy.zeros((10, 3, 2)))
     with pytest.raises(xcfun.XCFunException, match="Wrong shape of denshess argument"):
         pbe_fun.eval_potential_ab(numpy.zeros((10, 2)), numpy.zeros((10, 3, 2)), numpy.zeros((20, 6, 2)))
+
+
+def test_eval_into_strided(dens, densgrad):
+    fun = xcfun.xcfun_new()
+    xcfun.xcfun_set(fun, 'PBE', 1.0)
+    xcfun.xcfun_eval_setup(fun, xcfun.XC_N_NX_NY_NZ, xcfun.XC_PARTIAL_DERIVATIVES, 1)
+    rho = numpy.zeros((dens.size, 4))
+    rho[:, 0] = dens
+    rho[:, 1:4] = densgrad
+    ref = xcfun.xcfun_eval(fun, rho)
+
+    # Transposed input and every other column of the output are views
+    rho_t = numpy.asfortranarray(rho)
+    out = numpy.zeros((dens.size, 2 * ref.shape[1]))
+    for threads in (1, 3):
+        out[:] = 0.0
+        xcfun.xcfun_eval_into(fun, rho_t, out[:, ::2], threads=threads)
+        assert_allclose(out[:, ::2], ref)
+        assert not out[:, 1::2].any()
+
+    with pytest.raises(ValueError):
+        xcfun.xcfun_eval_into(fun, rho.astype(numpy.float32), out[:, ::2])
+    xcfun.xcfun_delete(fun)
+
+
+def test_eval_into_contracted(dens, densgrad):
+    fun = xcfun.xcfun_new()
+    xcfun.xcfun_set(fun, 'PBE', 1.0)
+    xcfun.xcfun_eval_setup(fun, xcfun.XC_N_NX_NY_NZ, xcfun.XC_PARTIAL_DERIVATIVES, 1)
+    rho = numpy.column_stack((dens, densgrad))
+    rho1 = 0.2 - 0.05 * rho
+    ref = xcfun.xcfun_eval(fun, rho)
+
+    # Each variable is followed by its first order perturbation
+    xcfun.xcfun_eval_setup(fun, xcfun.XC_N_NX_NY_NZ, xcfun.XC_CONTRACTED, 1)
+    contracted = numpy.stack((rho, rho1), axis=2).reshape(dens.size, 8)
+    out = numpy.zeros((dens.size, 2))
+    xcfun.xcfun_eval_into(fun, contracted, out)
+    assert_allclose(out[:, 0], ref[:, 0])
+    assert_allclose(out[:, 1], numpy.sum(ref[:, 1:] * rho1, axis=1))
+    xcfun.xcfun_delete(fun)
+
+def test_output_mask(dens, densgrad):
+    fun = xcfun.xcfun_new()
+    xcfun.xcfun_set(fun, 'PBE', 1.0)
+    xcfun.xcfun_eval_setup(fun, xcfun.XC_N_NX_NY_NZ, xcfun.XC_PARTIAL_DERIVATIVES, 2)
+    rho = numpy.zeros((dens.size, 4))
+    rho[:, 0] = dens
+    rho[:, 1:4] = densgrad
+    ref = xcfun.xcfun_eval(fun, rho)
+
+    # Unselected outputs are not written
+    mask = numpy.arange(ref.shape[1]) % 2 == 0
+    xcfun.xcfun_set_output_mask(fun, mask)
+    out = numpy.full_like(ref, 7.0)
+    xcfun.xcfun_eval_into(fun, rho, out)
+    assert_allclose(out[:, mask], ref[:, mask])
+    assert (out[:, ~mask] == 7.0).all()
+
+    with pytest.raises(ValueError):
+        xcfun.xcfun_set_output_mask(fun, mask[1:])
+    xcfun.xcfun_set_output_mask(fun, None)
+    assert_allclose(xcfun.xcfun_eval(fun, rho), ref)
+    xcfun.xcfun_delete(fun)
+
+
+def test_eval_planes(dens, densgrad):
+    fun = xcfun.xcfun_new()
+    xcfun.xcfun_set(fun, 'PBE', 1.0)
+    xcfun.xcfun_eval_setup(fun, xcfun.XC_N_NX_NY_NZ, xcfun.XC_PARTIAL_DERIVATIVES, 2)
+    rho = numpy.zeros((dens.size, 4))
+    rho[:, 0] = dens
+    rho[:, 1:4] = densgrad
+    ref = xcfun.xcfun_eval(fun, rho)
+
+    planes = xcfun.xcfun_eval_planes(fun, rho)
+    assert [p.shape for p in planes] == [(1, dens.size), (4, dens.size), (10, dens.size)]
+    assert_allclose(numpy.concatenate(planes).T, ref)
+
+    # Rows left out by the mask are zero
+    mask = numpy.arange(ref.shape[1]) % 3 == 1
+    xcfun.xcfun_set_output_mask(fun, mask)
+    rows = numpy.concatenate(xcfun.xcfun_eval_planes(fun, rho))
+    assert_allclose(rows[mask].T, ref[:, mask])
+    assert not rows[~mask].any()
+    xcfun.xcfun_delete(fun)
+
+
+def test_kernel_contraction(dens, densgrad):
+    fun = xcfun.xcfun_new()
+    xcfun.xcfun_set(fun, 'PBE', 1.0)
+    xcfun.xcfun_eval_setup(fun, xcfun.XC_N_NX_NY_NZ, xcfun.XC_PARTIAL_DERIVATIVES, 2)
+    rho = numpy.zeros((dens.size, 4))
+    rho[:, 0] = dens
+    rho[:, 1:4] = densgrad
+    rho1 = numpy.stack((0.1 * rho, 0.2 - 0.05 * rho), axis=1)
+    out = xcfun.xcfun_eval(fun, rho)
+
+    # Full second derivative matrices from the upper triangle
+    hess = numpy.zeros((dens.size, 4, 4))
+    iu = numpy.triu_indices(4)
+    hess[:, iu[0], iu[1]] = out[:, 5:]
+    hess[:, iu[1], iu[0]] = out[:, 5:]
+    ref = numpy.einsum('pij,paj->pai', hess, rho1)
+    assert_allclose(xcfun.xcfun_eval_kernel_contraction(fun, rho, rho1), ref, rtol=1e-10)
+    xcfun.xcfun_delete(fun)
+
+
+def test_eval_hessian_vector(dens, densgrad):
+    fun = xcfun.xcfun_new()
+    xcfun.xcfun_set(fun, 'PBE', 1.0)
+    xcfun.xcfun_eval_setup(fun, xcfun.XC_N_NX_NY_NZ, xcfun.XC_PARTIAL_DERIVATIVES, 2)
+    rho = numpy.zeros((dens.size, 4))
+    rho[:, 0] = dens
+    rho[:, 1:4] = densgrad
+    v = 0.2 - 0.05 * rho
+    out = xcfun.xcfun_eval(fun, rho)
+
+    hess = numpy.zeros((dens.size, 4, 4))
+    iu = numpy.triu_indices(4)
+    hess[:, iu[0], iu[1]] = out[:, 5:]
+    hess[:, iu[1], iu[0]] = out[:, 5:]
+    res = xcfun.xcfun_eval_hessian_vector(fun, rho, v)
+    assert res.shape == (dens.size, 9)
+    assert_allclose(res[:, :5], out[:, :5], rtol=1e-10)
+    assert_allclose(res[:, 5:], numpy.einsum('pij,pj->pi', hess, v), rtol=1e-10)
+    xcfun.xcfun_delete(fun)
+
+
+def test_eval_integrate(dens, densgrad):
+    fun = xcfun.xcfun_new()
+    xcfun.xcfun_set(fun, 'PBE', 1.0)
+    xcfun.xcfun_eval_setup(fun, xcfun.XC_N_NX_NY_NZ, xcfun.XC_PARTIAL_DERIVATIVES, 1)
+    rho = numpy.tile(numpy.column_stack((dens, densgrad)), (100, 1))
+    weights = numpy.linspace(0.1, 1.0, rho.shape[0])
+    energy = xcfun.xcfun_eval(fun, rho)[:, 0]
+
+    result = xcfun.xcfun_eval_integrate(fun, rho, weights)
+    assert_allclose(result, (weights @ energy, weights @ rho[:, 0]), rtol=1e-12)
+    # Bitwise the same with threads
+    for threads in (2, 3, 0):
+        assert xcfun.xcfun_eval_integrate(fun, rho, weights, threads=threads) == result
+    xcfun.xcfun_delete(fun)
+
+
+def test_eval_weighted(dens, densgrad):
+    fun = xcfun.xcfun_new()
+    xcfun.xcfun_set(fun, 'PBE', 1.0)
+    xcfun.xcfun_eval_setup(fun, xcfun.XC_N_NX_NY_NZ, xcfun.XC_PARTIAL_DERIVATIVES, 2)
+    rho = numpy.column_stack((dens, densgrad))
+    weights = numpy.linspace(-1.0, 1.0, dens.size)
+    ref = xcfun.xcfun_eval(fun, rho) * weights[:, numpy.newaxis]
+    assert_allclose(xcfun.xcfun_eval_weighted(fun, rho, weights), ref)
+    xcfun.xcfun_delete(fun)
+
+
+def test_spin_symmetry(dens, densgrad):
+    fun = xcfun.xcfun_new()
+    xcfun.xcfun_set(fun, 'PBE', 1.0)
+    xcfun.xcfun_eval_setup(fun, xcfun.XC_A_B_GAA_GAB_GBB, xcfun.XC_PARTIAL_DERIVATIVES, 2)
+    gaa = numpy.sum(densgrad**2, axis=1) / 4
+    rho = numpy.column_stack((dens / 2, dens / 2, gaa, gaa, gaa))
+    ref = xcfun.xcfun_eval(fun, rho)
+    assert xcfun.xcfun_set_spin_symmetry(fun, True) == 0
+    assert_allclose(xcfun.xcfun_eval(fun, rho), ref, rtol=1e-12)
+    xcfun.xcfun_delete(fun)
+
+
+def test_generated_kernels(dens, densgrad):
+    fun = xcfun.xcfun_new()
+    if xcfun.xcfun_set_generated_kernels(fun, True) != 0:
+        xcfun.xcfun_delete(fun)
+        pytest.skip('Not compiled with XCFUN_ENABLE_CODEGEN')
+    xcfun.xcfun_set(fun, 'PBE', 1.0)
+    xcfun.xcfun_set_generated_kernels(fun, False)
+    xcfun.xcfun_eval_setup(fun, xcfun.XC_A_B_GAA_GAB_GBB, xcfun.XC_PARTIAL_DERIVATIVES, 2)
+    gaa = numpy.sum(densgrad**2, axis=1) / 4
+    rho = numpy.column_stack((dens / 2, dens / 2, gaa, gaa, gaa))
+    ref = xcfun.xcfun_eval(fun, rho)
+    xcfun.xcfun_set_generated_kernels(fun, True)
+    assert xcfun.xcfun_uses_generated_kernels(fun)
+    assert_allclose(xcfun.xcfun_eval(fun, rho), ref, rtol=1e-10, atol=1e-14)
+    xcfun.xcfun_delete(fun)
+
+
+def test_jit(dens, densgrad, tmp_path, monkeypatch):
+    monkeypatch.setenv('XCFUN_JIT_CACHE', str(tmp_path))
+    fun = xcfun.xcfun_new()
+    if xcfun.xcfun_set_jit(fun, True) != 0:
+        xcfun.xcfun_delete(fun)
+        pytest.skip('Not compiled with XCFUN_ENABLE_JIT')
+    xcfun.xcfun_set(fun, 'PBEX', 0.75)
+    xcfun.xcfun_set(fun, 'BECKESRX', 0.25)
+    xcfun.xcfun_set(fun, 'PBEC', 1.0)
+    xcfun.xcfun_set(fun, 'RANGESEP_MU', 0.33)
+    xcfun.xcfun_set_jit(fun, False)
+    xcfun.xcfun_eval_setup(fun, xcfun.XC_A_B_GAA_GAB_GBB, xcfun.XC_PARTIAL_DERIVATIVES, 2)
+    gaa = numpy.sum(densgrad**2, axis=1) / 4
+    rho = numpy.column_stack((dens / 2, dens / 2, gaa, gaa, gaa))
+    ref = xcfun.xcfun_eval(fun, rho)
+    xcfun.xcfun_set_jit(fun, True)
+    assert xcfun.xcfun_uses_jit(fun)
+    assert_allclose(xcfun.xcfun_eval(fun, rho), ref, rtol=1e-10, atol=1e-14)
+    xcfun.xcfun_delete(fun)
+
+
+def test_functional_eval_chunks(pbe_fun, dens, densgrad, refen_pbe):
+    pbe_fun.setup(xcfun.XC_N_NX_NY_NZ, xcfun.XC_PARTIAL_DERIVATIVES, 0)
+    rho = numpy.zeros((dens.size, 4))
+    rho[:, 0] = dens
+    rho[:, 1:4] = densgrad
+    assert_allclose(pbe_fun.eval(rho)[:, 0], refen_pbe)
+
+    # Array sources are split in chunks, iterables are taken as they come
+    chunks = list(pbe_fun.eval_chunks(rho, chunk_size=3, threads=2))
+    assert [c.shape[0] for c in chunks] == [3, 3, 3, 1]
+    assert_allclose(numpy.concatenate(chunks)[:, 0], refen_pbe)
+    chunks = pbe_fun.eval_chunks(rho[i:i + 4] for i in range(0, dens.size, 4))
+    assert_allclose(numpy.concatenate(list(chunks))[:, 0], refen_pbe)
+
+
+def test_functional_eval_before_setup(lda_fun):
+    with pytest.raises(xcfun.XCFunException):
+        lda_fun.eval(numpy.ones((2, 1)))
+
+
+def test_functional_failed_setup(pbe_fun, dens, densgrad, refen_pbe):
+    pbe_fun.setup(xcfun.XC_N_NX_NY_NZ, xcfun.XC_PARTIAL_DERIVATIVES, 0)
+    # PBE needs the gradient, the previous setup stays in effect
+    with pytest.raises(xcfun.XCFunException):
+        pbe_fun.setup(xcfun.XC_N, xcfun.XC_PARTIAL_DERIVATIVES, 1)
+    assert pbe_fun.input_length == 4
+    assert pbe_fun.output_length == 1
+    rho = numpy.column_stack((dens, densgrad))
+    assert_allclose(pbe_fun.eval(rho)[:, 0], refen_pbe)
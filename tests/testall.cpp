@@ -1,9 +1,12 @@
 #include <cassert>
+#include <cfloat>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 #include "XCFun/xcfun.h"
+#include "tmath.hpp"
 
 void check(const char * what, int cond);
 void checknum(const char * what,
@@ -11,10 +14,37 @@ void checknum(const char * what,
               double xref,
               double abserr,
               double relerr);
+void checkoutputs(const char * what,
+                  const double out[],
+                  const double ref[],
+                  int n,
+                  double abserr,
+                  double relerr);
 void consistency_test();
 void gradient_forms_test();
+void alpha_vars_test();
 void user_setup_test();
 void xcfun_get_test();
+void lda_table_test();
+void vector_math_test();
+void single_precision_test();
+void profile_test();
+void strided_eval_test();
+void try_eval_test();
+void output_mask_test();
+void spin_symmetry_test();
+void planes_test();
+void kernel_contraction_test();
+void integrate_test();
+void weighted_eval_test();
+void adjoint_test();
+void hessian_vector_test();
+void generated_kernels_test();
+void jit_test();
+void term_weights_test();
+void workspace_test();
+int selective_build();
+int compiled(const char * name);
 
 /*
   Run all tests for all functionals.
@@ -48,8 +78,29 @@ void checknum(const char * what,
   exit(-1);
 }
 
+/* Compare n outputs with their reference values, each to relerr of its own
+   magnitude or to abserr, whichever is larger */
+void checkoutputs(const char * what,
+                  const double out[],
+                  const double ref[],
+                  int n,
+                  double abserr,
+                  double relerr) {
+  char item[128];
+  for (int k = 0; k < n; k++) {
+    /* Same bits, also for NaN, which -ffast-math cannot test for */
+    if (memcmp(&out[k], &ref[k], sizeof(double)) == 0)
+      continue;
+    double tol = relerr * fabs(ref[k]);
+    snprintf(item, sizeof(item), "%s, output %d", what, k);
+    checknum(item, out[k], ref[k], tol > abserr ? tol : abserr, 0);
+  }
+}
+
 /* Test permutation symmetries over variables and modes etc. */
 void consistency_test() {
+  if (!compiled("pbe"))
+    return;
   auto fun = xcfun_new();
   double d_unpolarized[8] = {1, 1, 2, -3, 4, 2, -3, 4};
   double d_pol_a[8] = {1, 2.1, 2, -3, 4, 7, -8, 9};
@@ -84,6 +135,8 @@ void consistency_test() {
 
 // Test that gradient square norma and gradient elements modes are consistent
 void gradient_forms_test() {
+  if (!compiled("blyp"))
+    return;
   auto fun = xcfun_new();
   double d_elements[8] = {1, 2.1, 1.1, 1.2, 1.3, 1.4, 1.5, 1.6};
   double d_sqnorm[5] = {d_elements[0], d_elements[1]};
@@ -135,7 +188,39 @@ void gradient_forms_test() {
   xcfun_delete(fun);
 }
 
+/* Alpha density vars give the same as spin resolved vars without beta
+   density, and setup only accepts vars that densvars unpacks */
+void alpha_vars_test() {
+  if (!(compiled("slaterx") && compiled("pbe")))
+    return;
+  double d_a[2] = {0.7, 0.3}, d_ab[5] = {0.7, 0.0, 0.3, 0.0, 0.0};
+  double out_a[3], out_ab[6];
+  auto fun = xcfun_new();
+  xcfun_set(fun, "slaterx", 1.0);
+  check("XC_A is set up", xcfun_eval_setup(fun, XC_A, XC_PARTIAL_DERIVATIVES, 1) == 0);
+  xcfun_eval(fun, d_a, out_a);
+  xcfun_eval_setup(fun, XC_A_B, XC_PARTIAL_DERIVATIVES, 1);
+  xcfun_eval(fun, d_ab, out_ab);
+  checknum("XC_A energy", out_a[0], out_ab[0], 1e-14, 1e-12);
+  checknum("XC_A alpha derivative", out_a[1], out_ab[1], 1e-14, 1e-12);
+  xcfun_set(fun, "slaterx", 0.0);
+  xcfun_set(fun, "pbe", 1.0);
+  check("XC_A_GAA is set up",
+        xcfun_eval_setup(fun, XC_A_GAA, XC_PARTIAL_DERIVATIVES, 1) == 0);
+  xcfun_eval(fun, d_a, out_a);
+  xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_PARTIAL_DERIVATIVES, 1);
+  xcfun_eval(fun, d_ab, out_ab);
+  checknum("XC_A_GAA energy", out_a[0], out_ab[0], 1e-14, 1e-10);
+  checknum("XC_A_GAA alpha derivative", out_a[1], out_ab[1], 1e-14, 1e-10);
+  checknum("XC_A_GAA gradient derivative", out_a[2], out_ab[3], 1e-14, 1e-10);
+  check("setup refuses vars that densvars does not unpack",
+        xcfun_eval_setup(fun, XC_A_2ND_TAYLOR, XC_PARTIAL_DERIVATIVES, 1) != 0);
+  xcfun_delete(fun);
+}
+
 void user_setup_test() {
+  if (!(compiled("lda") && compiled("pbe") && compiled("m06l")))
+    return;
   auto fun1 = xcfun_new();
   auto fun2 = xcfun_new();
   auto fun3 = xcfun_new();
@@ -154,6 +239,8 @@ void user_setup_test() {
 }
 
 void xcfun_get_test() {
+  if (!compiled("b3lyp"))
+    return;
   auto fun = xcfun_new();
   xcfun_set(fun, "B3LYP", 1.0);
 
@@ -176,15 +263,838 @@ void xcfun_get_test() {
   xcfun_delete(fun);
 }
 
+/* Compare tabulated LDA functionals with the analytic kernels up to third
+   order, also contracted. The tables cover 9e-4 < r_s < 1.1e3, that is
+   1.8e-10 < n < 3.1e8, and |zeta| < 0.9. Points outside, and terms or
+   orders without a table, must give the analytic results exactly. */
+void lda_table_test() {
+  const char * names[] = {"slaterx", "vwn3c", "vwn5c", "pw92c", "pz81c", "tfk"};
+  /* Lowest Taylor order that uses the table, -1 for none */
+  int table_order[] = {-1, 3, 0, 2, -1, -1};
+  /* n and zeta, the last four are outside */
+  double points[11][2] = {{0.8, 0.25},
+                          {0.03, -0.333},
+                          {5.5, 0.0},
+                          {1.0, 0.899},
+                          {1.0, -0.899},
+                          {3.0e8, 0.1},
+                          {2.0e-10, -0.1},
+                          {1.0, 0.95},
+                          {1.0, -0.97},
+                          {1.0e9, 0.1},
+                          {1.0e-11, 0.1}};
+  for (int f = 0; f < 6; f++) {
+    if (!compiled(names[f]))
+      continue;
+    auto fun = xcfun_new();
+    auto tab = xcfun_new();
+    xcfun_set(fun, names[f], 1.0);
+    xcfun_set(tab, names[f], 1.0);
+    check("negative table tolerance is rejected",
+          xcfun_set_lda_tables(tab, -1.0) != 0);
+    check("table tolerance is accepted", xcfun_set_lda_tables(tab, 1e-10) == 0);
+    /* Partial derivatives of order 0 to 3, then contracted of order 1 to 3 */
+    for (int m = 0; m < 7; m++) {
+      xcfun_mode mode = m < 4 ? XC_PARTIAL_DERIVATIVES : XC_CONTRACTED;
+      int order = m < 4 ? m : m - 3;
+      /* Highest Taylor order of the kernel calls */
+      int taylor = mode == XC_CONTRACTED ? order : (order == 1 ? 2 : order);
+      int tabulated = table_order[f] >= 0 && taylor >= table_order[f];
+      int len = mode == XC_CONTRACTED ? 1 << order : 1;
+      xcfun_eval_setup(fun, XC_A_B, mode, order);
+      check("tabulated functional is set up",
+            xcfun_eval_setup(tab, XC_A_B, mode, order) == 0);
+      int nout = xcfun_output_length(fun);
+      double d[16], ref[10], out[10];
+      double relerr[4] = {1e-9, 1e-7, 1e-4, 1e-2};
+      char what[80];
+      snprintf(what,
+               sizeof(what),
+               "table of %s, mode %d, order %d",
+               names[f],
+               (int)mode,
+               order);
+      for (int p = 0; p < 11; p++) {
+        double n = points[p][0], zeta = points[p][1];
+        /* Density, then the perturbations in contracted mode */
+        for (int k = 0; k < len; k++) {
+          d[k] = 0.5 * n * (1 + zeta) * (k ? 0.1 * k : 1);
+          d[len + k] = 0.5 * n * (1 - zeta) * (k ? 0.2 - 0.03 * k : 1);
+        }
+        xcfun_eval(fun, d, ref);
+        xcfun_eval(tab, d, out);
+        if (p >= 7 || !tabulated) {
+          int same = 1;
+          for (int i = 0; i < nout; i++)
+            same = same && out[i] == ref[i];
+          check(what, same);
+        } else {
+          /* The derivatives of the interpolant lose accuracy with their
+             order, most at the cell boundaries such as |zeta| = 0.9 */
+          for (int i = 0; i < nout; i++) {
+            int k = 0;
+            if (mode == XC_CONTRACTED)
+              for (int b = i; b; b >>= 1)
+                k += b & 1;
+            else
+              k = (i > 0) + (i > 2) + (i > 5);
+            checknum(what, out[i], ref[i], relerr[k] * fabs(ref[i]), 0);
+          }
+        }
+      }
+    }
+    xcfun_delete(fun);
+    xcfun_delete(tab);
+  }
+}
+
+/* The seeds of exp, log, pow, atan and asinh equal libm, with the in-tree
+   versions of XCFUN_ENABLE_VECTOR_MATH built with the flags of the kernels */
+void vector_math_test() {
+  for (int i = 0; i <= 1000; i++) {
+    double x = -700 + 1.4 * i;
+    double y = pow(10.0, -300 + 0.6 * i);
+    double z = 1e-3 + 0.005 * i, a = -2.5 + 0.005 * ((37 * i) % 1000);
+    double u = (i % 2 ? -1 : 1) * pow(10.0, -8 + 0.016 * i);
+    checknum("tmath_exp", tmath_exp(x) / exp(x), 1, 1e-12, 0);
+    checknum("tmath_log", tmath_log(y), log(y), 1e-12, 0);
+    checknum("tmath_pow", tmath_pow(z, a) / pow(z, a), 1, 1e-12, 0);
+    checknum("tmath_atan", tmath_atan(u) / atan(u), 1, 1e-14, 0);
+    checknum("tmath_asinh", tmath_asinh(u) / asinh(u), 1, 1e-14, 0);
+    float xf = x / 10;
+    checknum("float tmath_exp", tmath_exp(xf) / exp(double(xf)), 1, 1e-6, 0);
+  }
+  /* Edges of the domains */
+  check("exp underflows to zero", tmath_exp(-1000.0) == 0);
+  checknum("exp near overflow", tmath_exp(709.7) / exp(709.7), 1, 1e-12, 0);
+  checknum("log of the largest double", tmath_log(DBL_MAX), log(DBL_MAX), 1e-12, 0);
+  check("pow of zero", tmath_pow(0.0, 2.5) == 0);
+  check("zeroth power", tmath_pow(0.0, 0.0) == 1 && tmath_pow(7.0, 0.0) == 1);
+  checknum("atan of a large argument", tmath_atan(-1e300), -M_PI / 2, 1e-15, 0);
+  checknum("asinh of a large argument", tmath_asinh(1e300), asinh(1e300), 1e-12, 0);
+#ifndef __FAST_MATH__
+  /* -ffast-math assumes away infinities and NaN and flushes subnormals */
+  checknum("exp to a subnormal", tmath_exp(-720.0) / exp(-720.0), 1, 1e-9, 0);
+  check("exp overflows to inf", tmath_exp(1000.0) == HUGE_VAL);
+  checknum("log of a subnormal", tmath_log(5e-320), log(5e-320), 1e-12, 0);
+  check("log of zero", tmath_log(0.0) == -HUGE_VAL);
+  check("log of inf", tmath_log(HUGE_VAL) == HUGE_VAL);
+  check("log of a negative number", std::isnan(tmath_log(-1.0)));
+  check("pow of zero to a negative power", tmath_pow(0.0, -1.0) == HUGE_VAL);
+  check("atan of inf", tmath_atan(HUGE_VAL) == atan(HUGE_VAL));
+  check("asinh of inf", tmath_asinh(-HUGE_VAL) == -HUGE_VAL);
+  check("NaN propagates",
+        std::isnan(tmath_exp(NAN)) && std::isnan(tmath_log(NAN)) &&
+            std::isnan(tmath_pow(NAN, 2.0)) && std::isnan(tmath_atan(NAN)) &&
+            std::isnan(tmath_asinh(NAN)));
+#endif
+}
+
+/* Compare the single precision kernels of all functionals with the double
+   precision ones */
+void single_precision_test() {
+  double d[11] = {0.5, 0.3, 0.2, 0.05, 0.15, 0.4, 0.3, 0.6, 0.4, 0.0, 0.0};
+  double ref[78], out[78];
+  const char * n;
+  int i = 0;
+  auto probe = xcfun_new();
+  check("double precision can always be selected",
+        xcfun_set_single_precision(probe, false) == 0);
+  int have_single = xcfun_set_single_precision(probe, true) == 0;
+  xcfun_delete(probe);
+  if (!have_single)
+    return; /* Not compiled with XCFUN_ENABLE_SINGLE */
+  while ((n = xcfun_enumerate_parameters(i++))) {
+    auto fun = xcfun_new();
+    auto sfun = xcfun_new();
+    xcfun_set(fun, n, 1.0);
+    xcfun_set(sfun, n, 1.0);
+    xcfun_set_single_precision(sfun, true);
+    if (xcfun_eval_setup(fun,
+                         XC_A_B_GAA_GAB_GBB_LAPA_LAPB_TAUA_TAUB_JPAA_JPBB,
+                         XC_PARTIAL_DERIVATIVES,
+                         2) == 0) {
+      xcfun_eval_setup(sfun,
+                       XC_A_B_GAA_GAB_GBB_LAPA_LAPB_TAUA_TAUB_JPAA_JPBB,
+                       XC_PARTIAL_DERIVATIVES,
+                       2);
+      char what[64];
+      snprintf(what, sizeof(what), "single precision %s", n);
+      xcfun_eval(fun, d, ref);
+      xcfun_eval(sfun, d, out);
+      checkoutputs(what, out, ref, xcfun_output_length(fun), 1e-5, 1e-5);
+    }
+    xcfun_delete(fun);
+    xcfun_delete(sfun);
+  }
+}
+
+/* Count points and kernel calls of a two-term functional */
+void profile_test() {
+  if (!(compiled("slaterx") && compiled("vwn5c")))
+    return;
+  double d[20];
+  unsigned long long points, calls, cycles;
+  auto fun = xcfun_new();
+  xcfun_set(fun, "slaterx", 1.0);
+  xcfun_set(fun, "vwn5c", 1.0);
+  int err = xcfun_get_profile(
+      fun, "slaterx", XC_PARTIAL_DERIVATIVES, 1, &points, &calls, &cycles);
+  if (err != 0) {
+    xcfun_delete(fun);
+    return; /* Not compiled with XCFUN_ENABLE_PROFILING */
+  }
+  check("profile starts at zero", points == 0 && calls == 0 && cycles == 0);
+  check("profile needs a functional name",
+        xcfun_get_profile(
+            fun, "blyp", XC_PARTIAL_DERIVATIVES, 1, &points, &calls, &cycles) != 0);
+  xcfun_eval_setup(fun, XC_A_B, XC_PARTIAL_DERIVATIVES, 1);
+  for (int i = 0; i < 10; i++) {
+    d[2 * i] = 0.1 * (i + 1);
+    d[2 * i + 1] = 0.05 * (i + 1);
+  }
+  double out[30];
+  xcfun_eval_vec(fun, 10, d, 2, out, 3);
+  /* First derivatives of two variables take one call of the order 2 kernel */
+  xcfun_get_profile(
+      fun, "vwn5c", XC_PARTIAL_DERIVATIVES, 1, &points, &calls, &cycles);
+  check("profile counts points", points == 10);
+  check("profile counts kernel calls", calls == 10);
+  xcfun_get_profile(
+      fun, "vwn5c", XC_PARTIAL_DERIVATIVES, 2, &points, &calls, &cycles);
+  check("profile separates orders", points == 0 && calls == 0);
+  xcfun_reset_profile(fun);
+  xcfun_get_profile(
+      fun, "slaterx", XC_PARTIAL_DERIVATIVES, 1, &points, &calls, &cycles);
+  check("profile is reset", points == 0 && calls == 0 && cycles == 0);
+  xcfun_delete(fun);
+}
+
+/* Evaluate variable-major input into a transposed, reversed output */
+void strided_eval_test() {
+  if (!compiled("pbe"))
+    return;
+  const int np = 4;
+  double d[5 * np], dt[5 * np], ref[21 * np], out[21 * np];
+  auto fun = xcfun_new();
+  xcfun_set(fun, "pbe", 1.0);
+  xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_PARTIAL_DERIVATIVES, 2);
+  for (int p = 0; p < np; p++)
+    for (int i = 0; i < 5; i++) {
+      d[5 * p + i] = 0.1 * (p + 1) + 0.05 * i;
+      dt[i * np + p] = d[5 * p + i];
+    }
+  xcfun_eval_vec(fun, np, d, 5, ref, 21);
+  xcfun_eval_vec_strided(fun, np, dt, 1, np, out + 21 * np - 1, -1, -np);
+  for (int p = 0; p < np; p++)
+    for (int i = 0; i < 21; i++)
+      checknum("strided evaluation",
+               out[21 * np - 1 - p - i * np],
+               ref[21 * p + i],
+               1e-14 * fabs(ref[21 * p + i]) + 1e-20,
+               0);
+  /* Outputs left out by the mask are not written through the stride either */
+  int mask[21];
+  for (int i = 0; i < 21; i++)
+    mask[i] = (i % 3 == 1);
+  xcfun_set_output_mask(fun, mask);
+  for (int k = 0; k < 21 * np; k++)
+    out[k] = -1e30;
+  xcfun_eval_vec_strided(fun, np, dt, 1, np, out + 21 * np - 1, -1, -np);
+  for (int p = 0; p < np; p++)
+    for (int i = 0; i < 21; i++)
+      checknum("strided masked evaluation",
+               out[21 * np - 1 - p - i * np],
+               mask[i] ? ref[21 * p + i] : -1e30,
+               1e-14 * fabs(ref[21 * p + i]) + 1e-20,
+               0);
+  xcfun_delete(fun);
+}
+
+/* Errors are returned by setup and the try functions, never fatal */
+void try_eval_test() {
+  if (!(compiled("slaterx") && compiled("pbex")))
+    return;
+  double d[2] = {0.5, 0.3}, out[3];
+  auto fun = xcfun_new();
+  check("try_eval needs a setup", xcfun_try_eval(fun, d, out) == 8);
+  xcfun_set(fun, "slaterx", 1.0);
+  check("setup refuses vars the evaluation does not implement",
+        xcfun_eval_setup(fun, XC_A_2ND_TAYLOR, XC_POTENTIAL, 1) != 0);
+  check("setup refuses fourth order partial derivatives",
+        xcfun_eval_setup(fun, XC_A_B, XC_PARTIAL_DERIVATIVES, 4) != 0);
+  check("try_eval_vec needs a setup",
+        xcfun_try_eval_vec(fun, 1, d, 2, out, 3) == 8);
+  xcfun_eval_setup(fun, XC_A_B, XC_PARTIAL_DERIVATIVES, 1);
+  check("try_eval after setup", xcfun_try_eval(fun, d, out) == 0);
+  xcfun_set(fun, "slaterx", 0.5);
+  check("reweighting keeps the setup", xcfun_try_eval(fun, d, out) == 0);
+  xcfun_set(fun, "pbex", 1.0);
+  check("new functional invalidates the setup",
+        xcfun_try_eval_vec(fun, 1, d, 2, out, 3) == 8);
+  check("setup refuses vars without the gradients of a GGA",
+        xcfun_eval_setup(fun, XC_A_B, XC_PARTIAL_DERIVATIVES, 1) != 0);
+  xcfun_delete(fun);
+  fun = xcfun_new();
+  if (xcfun_set(fun, "tpssx", 1.0) == 0) {
+    check("setup refuses density vars for a meta-GGA",
+          xcfun_eval_setup(fun, XC_A_B, XC_PARTIAL_DERIVATIVES, 1) != 0);
+    check("setup refuses GGA vars for a meta-GGA",
+          xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_CONTRACTED, 1) != 0);
+    check("try_eval after a refused setup",
+          xcfun_try_eval(fun, d, out) == 8);
+  }
+  xcfun_delete(fun);
+}
+
+/* Selected partial derivatives equal the full ones, the rest is untouched */
+void output_mask_test() {
+  if (!compiled("pbe"))
+    return;
+  double d[5] = {0.39, 0.31, 0.21, 0.15, 0.24}, full[56], part[56];
+  int mask[56];
+  auto fun = xcfun_new();
+  xcfun_set(fun, "pbe", 1.0);
+  check("output mask needs a setup", xcfun_set_output_mask(fun, mask) == -1);
+  for (int order = 0; order <= 3; order++)
+    for (int pattern = 0; pattern < 3; pattern++) {
+      xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_PARTIAL_DERIVATIVES, order);
+      int nout = xcfun_output_length(fun);
+      xcfun_eval(fun, d, full);
+      for (int k = 0; k < nout; k++) {
+        /* Every third output, only the energy, or only the last output */
+        if (pattern == 0)
+          mask[k] = (k % 3 == 1);
+        else
+          mask[k] = (pattern == 1) ? (k == 0) : (k == nout - 1);
+        part[k] = -1e30;
+      }
+      check("set output mask", xcfun_set_output_mask(fun, mask) == 0);
+      xcfun_eval(fun, d, part);
+      for (int k = 0; k < nout; k++)
+        checknum("masked output", part[k], mask[k] ? full[k] : -1e30, 1e-14, 1e-12);
+    }
+  xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_CONTRACTED, 1);
+  check("no output mask in contracted mode",
+        xcfun_set_output_mask(fun, mask) == -1);
+  xcfun_delete(fun);
+}
+
+/* Closed-shell points give the same derivatives with the mirrored ones copied */
+void spin_symmetry_test() {
+  if (!compiled("pbe"))
+    return;
+  double d[5] = {0.39, 0.39, 0.21, 0.15, 0.21}, full[56], sym[56];
+  int mask[56];
+  auto fun = xcfun_new();
+  xcfun_set(fun, "pbe", 1.0);
+  for (int order = 0; order <= 3; order++) {
+    xcfun_set_spin_symmetry(fun, 0);
+    xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_PARTIAL_DERIVATIVES, order);
+    int nout = xcfun_output_length(fun);
+    xcfun_eval(fun, d, full);
+    check("enable spin symmetry", xcfun_set_spin_symmetry(fun, 1) == 0);
+    xcfun_eval(fun, d, sym);
+    for (int k = 0; k < nout; k++)
+      checknum("spin symmetric output", sym[k], full[k], 1e-12, 1e-12);
+    check("alpha and beta derivatives are copies", order == 0 || sym[1] == sym[2]);
+    /* Only the mirror of a selected output is computed */
+    for (int k = 0; k < nout; k++) {
+      mask[k] = (k % 2 == 0);
+      sym[k] = -1e30;
+    }
+    xcfun_set_output_mask(fun, mask);
+    xcfun_eval(fun, d, sym);
+    for (int k = 0; k < nout; k++)
+      checknum("spin symmetric masked output",
+               sym[k],
+               mask[k] ? full[k] : -1e30,
+               1e-12,
+               1e-12);
+  }
+  /* The total density has no alpha/beta mirror */
+  xcfun_set_spin_symmetry(fun, 0);
+  xcfun_eval_setup(fun, XC_N_GNN, XC_PARTIAL_DERIVATIVES, 1);
+  check("no spin symmetry of the total density",
+        xcfun_set_spin_symmetry(fun, 1) != 0);
+  xcfun_eval_setup(fun, XC_A_B_2ND_TAYLOR, XC_POTENTIAL, 1);
+  check("no spin symmetry of the potential", xcfun_set_spin_symmetry(fun, 1) != 0);
+  xcfun_delete(fun);
+}
+
+/* One plane per order holds the same derivatives as xcfun_eval_vec */
+void planes_test() {
+  if (!compiled("pbe"))
+    return;
+  const int np = 101, nout = 56;
+  double * d = (double *)malloc(5 * np * sizeof(double));
+  double * ref = (double *)malloc(nout * np * sizeof(double));
+  double * mem = (double *)malloc((nout * (np + 1) + 1) * sizeof(double));
+  int count[4] = {1, 5, 15, 35};
+  auto fun = xcfun_new();
+  xcfun_set(fun, "pbe", 1.0);
+  xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_PARTIAL_DERIVATIVES, 3);
+  for (int p = 0; p < np; p++) {
+    d[5 * p] = 0.3 + 0.01 * p;
+    d[5 * p + 1] = 0.2 + 0.005 * p;
+    d[5 * p + 2] = 0.1 + 0.002 * p;
+    d[5 * p + 3] = 0.04;
+    d[5 * p + 4] = 0.09 - 0.0005 * p;
+  }
+  xcfun_eval_vec(fun, np, d, 5, ref, nout);
+  /* An even pitch takes the streaming stores, an odd one and an odd offset
+     the plain stores */
+  for (int pitch = np; pitch <= np + 1; pitch++)
+    for (int offset = 0; offset <= 1; offset++) {
+      double * planes[4];
+      for (int k = 0, first = 0; k < 4; first += count[k++])
+        planes[k] = mem + offset + first * pitch;
+      check("evaluate into planes",
+            xcfun_eval_vec_planes(fun, np, d, 5, planes, pitch) == 0);
+      for (int k = 0, first = 0; k < 4; first += count[k++])
+        for (int c = 0; c < count[k]; c++)
+          for (int p = 0; p < np; p++)
+            checknum("plane output",
+                     planes[k][c * pitch + p],
+                     ref[p * nout + first + c],
+                     1e-14,
+                     1e-14);
+    }
+  double * none[4] = {NULL, NULL, NULL, NULL};
+  check("planes need room for the points",
+        xcfun_eval_vec_planes(fun, np, d, 5, none, np - 1) == -1);
+  xcfun_delete(fun);
+  free(d);
+  free(ref);
+  free(mem);
+}
+
+/* Contracted kernel equals the second derivatives times the perturbations */
+void kernel_contraction_test() {
+  if (!compiled("b3lyp"))
+    return;
+  const int np = 3, nv = 8, npert = 2, nout = 45;
+  double d[np * nv], pert[np * npert * nv], v[np * npert * nv], f[nout];
+  auto fun = xcfun_new();
+  xcfun_set(fun, "b3lyp", 1.0);
+  xcfun_eval_setup(fun, XC_A_B_AX_AY_AZ_BX_BY_BZ, XC_PARTIAL_DERIVATIVES, 2);
+  for (int i = 0; i < np * nv; i++)
+    d[i] = 0.2 + 0.05 * (i % 7) - 0.1 * (i % nv >= 2);
+  for (int i = 0; i < np * npert * nv; i++)
+    pert[i] = 0.3 * sin(1.0 + i);
+  check("evaluate the contracted kernel",
+        xcfun_eval_kernel_contraction(
+            fun, np, d, nv, npert, pert, npert * nv, v, npert * nv) == 0);
+  for (int p = 0; p < np; p++) {
+    xcfun_eval(fun, d + p * nv, f);
+    for (int a = 0; a < npert; a++)
+      for (int i = 0; i < nv; i++) {
+        double ref = 0;
+        for (int j = 0; j < nv; j++) {
+          /* Upper triangle of the second derivatives after the gradient */
+          int lo = i < j ? i : j, hi = i < j ? j : i;
+          int k = 1 + nv + lo * nv - lo * (lo - 1) / 2 + (hi - lo);
+          ref += f[k] * pert[(p * npert + a) * nv + j];
+        }
+        checknum(
+            "contracted kernel", v[(p * npert + a) * nv + i], ref, 1e-12, 1e-10);
+      }
+  }
+  xcfun_eval_setup(fun, XC_A_B_AX_AY_AZ_BX_BY_BZ, XC_PARTIAL_DERIVATIVES, 1);
+  check("contracted kernel needs a second order setup",
+        xcfun_eval_kernel_contraction(fun, np, d, nv, npert, pert, 0, v, 0) == -1);
+  xcfun_delete(fun);
+}
+
+/* Weighted sums over more than one block of points */
+void integrate_test() {
+  if (!(compiled("pbe") && compiled("slaterx")))
+    return;
+  const int np = 600;
+  double * d = (double *)malloc(5 * np * sizeof(double));
+  double * w = (double *)malloc(np * sizeof(double));
+  double * out = (double *)malloc(21 * np * sizeof(double));
+  double energy, electrons, e_ref = 0, n_ref = 0;
+  auto fun = xcfun_new();
+  xcfun_set(fun, "pbe", 1.0);
+  xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_PARTIAL_DERIVATIVES, 2);
+  for (int p = 0; p < np; p++) {
+    d[5 * p] = 0.01 + 0.002 * p;
+    d[5 * p + 1] = 0.02 + 0.001 * p;
+    d[5 * p + 2] = 0.001 * p;
+    d[5 * p + 3] = 0.0005 * p;
+    d[5 * p + 4] = 0.0007 * p;
+    w[p] = 0.5 + 0.25 * sin(0.1 * p);
+  }
+  xcfun_eval_vec(fun, np, d, 5, out, 21);
+  for (int p = 0; p < np; p++) {
+    e_ref += w[p] * out[21 * p];
+    n_ref += w[p] * (d[5 * p] + d[5 * p + 1]);
+  }
+  check("integrate",
+        xcfun_eval_integrate(fun, np, d, 5, w, &energy, &electrons) == 0);
+  checknum("integrated energy", energy, e_ref, 1e-10, 1e-12);
+  checknum("integrated electrons", electrons, n_ref, 1e-10, 1e-12);
+  /* Contracted mode input has the values first in each group of two */
+  for (int i = 5 * np - 1; i >= 0; i--) {
+    out[2 * i] = d[i];
+    out[2 * i + 1] = 1.0;
+  }
+  xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_CONTRACTED, 1);
+  check("integrate without electrons",
+        xcfun_eval_integrate(fun, np, out, 10, w, &energy, NULL) == 0);
+  checknum("energy with any setup", energy, e_ref, 1e-10, 1e-12);
+  /* Alpha density alone, the electrons are those of the input */
+  for (int p = 0; p < np; p++) {
+    out[2 * p] = d[5 * p];
+    out[2 * p + 1] = d[5 * p + 2];
+  }
+  xcfun_eval_setup(fun, XC_A_GAA, XC_PARTIAL_DERIVATIVES, 0);
+  xcfun_eval_vec(fun, np, out, 2, out + 2 * np, 1);
+  e_ref = n_ref = 0;
+  for (int p = 0; p < np; p++) {
+    e_ref += w[p] * out[2 * np + p];
+    n_ref += w[p] * out[2 * p];
+  }
+  check("integrate alpha density",
+        xcfun_eval_integrate(fun, np, out, 2, w, &energy, &electrons) == 0);
+  checknum("integrated alpha energy", energy, e_ref, 1e-10, 1e-12);
+  checknum("integrated alpha electrons", electrons, n_ref, 1e-14, 1e-14);
+  for (int p = 0; p < np; p++)
+    out[2 * p] = 0;
+  xcfun_eval_integrate(fun, np, out, 2, w, &energy, &electrons);
+  check("no electrons without density", electrons == 0);
+  xcfun_set(fun, "slaterx", 1.0);
+  check("integrate needs a setup",
+        xcfun_eval_integrate(fun, np, d, 5, w, &energy, NULL) == 8);
+  xcfun_delete(fun);
+  free(d);
+  free(w);
+  free(out);
+}
+
+/* Weighted outputs are the outputs times the weights */
+void weighted_eval_test() {
+  if (!compiled("pbe"))
+    return;
+  const int np = 3;
+  double d[5 * np], w[np] = {0.5, -2.0, 0.0}, ref[21 * np], out[22 * np];
+  auto fun = xcfun_new();
+  xcfun_set(fun, "pbe", 1.0);
+  for (int i = 0; i < 5 * np; i++)
+    d[i] = 0.1 + 0.03 * i;
+  check("weighted evaluation needs a setup",
+        xcfun_eval_vec_weighted(fun, np, d, 5, w, out, 22) == 8);
+  xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_PARTIAL_DERIVATIVES, 2);
+  xcfun_eval_vec(fun, np, d, 5, ref, 21);
+  check("weighted evaluation",
+        xcfun_eval_vec_weighted(fun, np, d, 5, w, out, 22) == 0);
+  for (int p = 0; p < np; p++)
+    for (int k = 0; k < 21; k++)
+      checknum(
+          "weighted output", out[22 * p + k], w[p] * ref[21 * p + k], 1e-14, 1e-14);
+  xcfun_delete(fun);
+}
+
+/* Reverse mode gradients and Hessian-vector products of all functionals
+   equal those from the derivatives of order 2 */
+void adjoint_test() {
+  double d[11] = {0.39, 0.28, 0.21, 0.15, 0.19, 0.1, 0.12, 0.3, 0.25, 0.01, 0.02};
+  double v[11] = {0.3, -0.2, 0.1, 0.05, -0.1, 0.2, 0.1, -0.3, 0.2, 0.05, 0.1};
+  double grad[12], hv[23], ref[78];
+  int i = 0;
+  const char * n;
+  while ((n = xcfun_enumerate_parameters(i++))) {
+    auto fun = xcfun_new();
+    xcfun_set(fun, n, 1.0);
+    if (xcfun_eval_setup(fun,
+                         XC_A_B_GAA_GAB_GBB_LAPA_LAPB_TAUA_TAUB_JPAA_JPBB,
+                         XC_PARTIAL_DERIVATIVES,
+                         1) == 0) {
+      xcfun_eval(fun, d, grad);
+      xcfun_eval_setup(fun,
+                       XC_A_B_GAA_GAB_GBB_LAPA_LAPB_TAUA_TAUB_JPAA_JPBB,
+                       XC_PARTIAL_DERIVATIVES,
+                       2);
+      xcfun_eval(fun, d, ref);
+      for (int k = 0; k < 12; k++)
+        checknum(n, grad[k], ref[k], 1e-12, 1e-10);
+      xcfun_eval_hessian_vector(fun, 1, d, 11, v, 11, hv, 23);
+      for (int k = 0; k < 11; k++) {
+        double hvref = 0;
+        for (int j = 0; j < 11; j++) {
+          int lo = k < j ? k : j, hi = k < j ? j : k;
+          hvref += ref[12 + lo * 11 - lo * (lo - 1) / 2 + (hi - lo)] * v[j];
+        }
+        checknum(n, hv[12 + k], hvref, 1e-12, 1e-10);
+      }
+    }
+    xcfun_delete(fun);
+  }
+}
+
+/* Gradient and Hessian-vector product from the full second derivatives */
+void hessian_vector_test() {
+  const char * names[2] = {"b3lyp", "m06"};
+  xcfun_vars vars[2] = {XC_A_B_AX_AY_AZ_BX_BY_BZ, XC_A_B_GAA_GAB_GBB_TAUA_TAUB};
+  const int np = 3, nv = 8;
+  double d[np * nv], v[np * nv], hv[np * (1 + 2 * nv)], f[45];
+  for (int i = 0; i < np * nv; i++) {
+    d[i] = 0.2 + 0.05 * (i % 7) - 0.1 * (i % nv >= 2);
+    v[i] = 0.3 * sin(1.0 + i);
+  }
+  for (int t = 0; t < 2; t++) {
+    if (!compiled(names[t]))
+      continue;
+    auto fun = xcfun_new();
+    xcfun_set(fun, names[t], 1.0);
+    xcfun_eval_setup(fun, vars[t], XC_PARTIAL_DERIVATIVES, 2);
+    int n = xcfun_input_length(fun), m = 1 + 2 * n;
+    check("evaluate Hessian-vector products",
+          xcfun_eval_hessian_vector(fun, np, d, nv, v, nv, hv, m) == 0);
+    for (int p = 0; p < np; p++) {
+      xcfun_eval(fun, d + p * nv, f);
+      for (int i = 0; i <= n; i++)
+        checknum("Hessian-vector gradient", hv[p * m + i], f[i], 1e-12, 1e-10);
+      for (int i = 0; i < n; i++) {
+        double ref = 0;
+        for (int j = 0; j < n; j++) {
+          int lo = i < j ? i : j, hi = i < j ? j : i;
+          int k = 1 + n + lo * n - lo * (lo - 1) / 2 + (hi - lo);
+          ref += f[k] * v[p * nv + j];
+        }
+        checknum("Hessian-vector product", hv[p * m + 1 + n + i], ref, 1e-12, 1e-10);
+      }
+    }
+    xcfun_eval_setup(fun, vars[t], XC_PARTIAL_DERIVATIVES, 1);
+    check("Hessian-vector product needs a second order setup",
+          xcfun_eval_hessian_vector(fun, np, d, nv, v, nv, hv, m) == -1);
+    xcfun_delete(fun);
+  }
+}
+
+/* Compare the generated kernels with the Taylor kernels of every functional */
+void generated_kernels_test() {
+  const xcfun_vars vars[] = {XC_N,
+                             XC_A_B,
+                             XC_N_GNN,
+                             XC_A_B_GAA_GAB_GBB,
+                             XC_N_GNN_TAUN,
+                             XC_A_B_GAA_GAB_GBB_TAUA_TAUB};
+  const double d[6][7] = {{0.8},
+                          {0.5, 0.3},
+                          {0.8, 0.35},
+                          {0.5, 0.3, 0.2, 0.05, 0.15},
+                          {0.8, 0.35, 0.7},
+                          {0.5, 0.3, 0.2, 0.05, 0.15, 0.4, 0.3}};
+  double ref[36], out[36];
+  const char * n;
+  int i = 0;
+  auto probe = xcfun_new();
+  int have_generated = xcfun_set_generated_kernels(probe, true) == 0;
+  xcfun_delete(probe);
+  if (!have_generated)
+    return; /* Not compiled with XCFUN_ENABLE_CODEGEN */
+  while ((n = xcfun_enumerate_parameters(i++))) {
+    auto fun = xcfun_new();
+    if (xcfun_set(fun, n, 1.0) != 0) {
+      xcfun_delete(fun);
+      continue;
+    }
+    for (int t = 0; t < 6; t++) {
+      for (int order = 0; order <= 2; order++) {
+        xcfun_set_generated_kernels(fun, false);
+        if (xcfun_eval_setup(fun, vars[t], XC_PARTIAL_DERIVATIVES, order) != 0)
+          continue;
+        int nout = xcfun_output_length(fun);
+        xcfun_eval(fun, d[t], ref);
+        xcfun_set_generated_kernels(fun, true);
+        xcfun_eval(fun, d[t], out);
+        char what[96];
+        snprintf(what,
+                 sizeof(what),
+                 "generated kernel %s, vars %d, order %d",
+                 n,
+                 (int)vars[t],
+                 order);
+        checkoutputs(what, out, ref, nout, 1e-10, 1e-10);
+      }
+    }
+    xcfun_delete(fun);
+  }
+  if (!compiled("pbex"))
+    return;
+  auto fun = xcfun_new();
+  xcfun_set(fun, "pbex", 1.0);
+  xcfun_set_generated_kernels(fun, true);
+  xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_PARTIAL_DERIVATIVES, 2);
+  check("pbex uses the generated kernels", xcfun_uses_generated_kernels(fun));
+  xcfun_set_generated_kernels(fun, false);
+  check("generated kernels can be switched off", !xcfun_uses_generated_kernels(fun));
+  xcfun_delete(fun);
+}
+
+/* Compare the run time compiled kernel of a mixture with the Taylor kernels */
+void jit_test() {
+  if (!(compiled("pbex") && compiled("beckesrx") && compiled("pbec")))
+    return;
+  double d[5] = {0.5, 0.3, 0.2, 0.05, 0.15};
+  double mu[2] = {0.4, 0.2};
+  double ref[21], out[21];
+  auto fun = xcfun_new();
+  if (xcfun_set_jit(fun, true) != 0) {
+    xcfun_delete(fun);
+    return; /* Not compiled with XCFUN_ENABLE_JIT */
+  }
+  xcfun_set(fun, "pbex", 0.8);
+  xcfun_set(fun, "beckesrx", 0.2);
+  xcfun_set(fun, "pbec", 1.0);
+  for (int m = 0; m < 2; m++) {
+    /* The parameters are constants of the kernel */
+    xcfun_set(fun, "rangesep_mu", mu[m]);
+    for (int order = 0; order <= 2; order++) {
+      xcfun_set_jit(fun, false);
+      xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_PARTIAL_DERIVATIVES, order);
+      int nout = xcfun_output_length(fun);
+      xcfun_eval(fun, d, ref);
+      xcfun_set_jit(fun, true);
+      check("mixture uses the compiled kernel", xcfun_uses_jit(fun));
+      xcfun_eval(fun, d, out);
+      checkoutputs("compiled kernel", out, ref, nout, 1e-10, 1e-10);
+    }
+  }
+  /* Setting a parameter after the setup drops the kernel of the old value */
+  xcfun_set(fun, "rangesep_mu", mu[0]);
+  xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_PARTIAL_DERIVATIVES, 1);
+  check("mixture uses the compiled kernel", xcfun_uses_jit(fun));
+  xcfun_set(fun, "rangesep_mu", mu[1]);
+  check("xcfun_set drops the compiled kernel", !xcfun_uses_jit(fun));
+  xcfun_eval(fun, d, out);
+  xcfun_set_jit(fun, false);
+  xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_PARTIAL_DERIVATIVES, 1);
+  xcfun_eval(fun, d, ref);
+  checkoutputs("parameter set after the setup", out, ref, 6, 1e-10, 1e-10);
+  xcfun_set_jit(fun, true);
+  xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_PARTIAL_DERIVATIVES, 3);
+  check("third derivatives use the Taylor kernels", !xcfun_uses_jit(fun));
+  xcfun_delete(fun);
+}
+
+/* Setting a functional again adds to the weight of its term */
+void term_weights_test() {
+  if (!(compiled("pbex") && compiled("slaterx")))
+    return;
+  double d[5] = {0.39, 0.31, 0.21, 0.15, 0.24}, ref[6], out[6], w;
+  auto fun = xcfun_new();
+  auto once = xcfun_new();
+  xcfun_set(fun, "pbex", 0.3);
+  xcfun_set(fun, "slaterx", 1.0);
+  xcfun_set(fun, "pbex", 0.5);
+  xcfun_set(once, "pbex", 0.8);
+  xcfun_set(once, "slaterx", 1.0);
+  xcfun_get(fun, "pbex", &w);
+  checknum("weight of a functional set twice", w, 0.8, 1e-15, 0);
+  for (int order = 0; order <= 1; order++) {
+    xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_PARTIAL_DERIVATIVES, order);
+    xcfun_eval_setup(once, XC_A_B_GAA_GAB_GBB, XC_PARTIAL_DERIVATIVES, order);
+    xcfun_eval(fun, d, out);
+    xcfun_eval(once, d, ref);
+    for (int k = 0; k < xcfun_output_length(fun); k++)
+      checknum("functional set twice", out[k], ref[k], 1e-14, 1e-14);
+  }
+  xcfun_delete(fun);
+  xcfun_delete(once);
+}
+
+/* The scratch of the high order passes is kept between calls, also when the
+   vars change or another functional object is evaluated */
+void workspace_test() {
+  if (!compiled("pbe"))
+    return;
+  double d[5] = {0.39, 0.31, 0.21, 0.15, 0.24};
+  double in[40] = {0}, ref[56], out[56], other[56];
+  auto fun = xcfun_new();
+  auto spin = xcfun_new();
+  xcfun_set(fun, "pbe", 1.0);
+  xcfun_set(spin, "pbe", 1.0);
+  for (int i = 0; i < 5; i++) {
+    in[8 * i] = d[i];
+    in[8 * i + 1] = 0.01 * (i + 1);
+    in[8 * i + 2] = 0.02;
+  }
+  xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_CONTRACTED, 3);
+  xcfun_eval(fun, in, ref);
+  xcfun_eval_setup(spin, XC_N_S_GNN_GNS_GSS, XC_CONTRACTED, 3);
+  xcfun_eval(spin, in, other);
+  xcfun_eval(fun, in, out);
+  for (int k = 0; k < 8; k++)
+    check("contracted again after other vars", out[k] == ref[k]);
+  xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_PARTIAL_DERIVATIVES, 3);
+  xcfun_eval(fun, d, ref);
+  checknum("energy of the contracted passes", out[0], ref[0], 1e-14, 1e-14);
+  xcfun_eval_setup(fun, XC_N_S_GNN_GNS_GSS, XC_PARTIAL_DERIVATIVES, 3);
+  xcfun_eval(fun, d, other);
+  xcfun_eval_setup(fun, XC_A_B_GAA_GAB_GBB, XC_PARTIAL_DERIVATIVES, 3);
+  xcfun_eval(fun, d, out);
+  for (int k = 0; k < 56; k++)
+    check("third derivatives again after other vars", out[k] == ref[k]);
+  xcfun_delete(fun);
+  xcfun_delete(spin);
+}
+
+/* True if functionals were left out with XCFUN_FUNCTIONALS */
+int selective_build() {
+  int i = 0, missing = 0;
+  const char * n;
+  while ((n = xcfun_enumerate_parameters(i++))) {
+    auto fun = xcfun_new();
+    if (xcfun_set(fun, n, 1.0) != 0)
+      missing++;
+    xcfun_delete(fun);
+  }
+  return missing > 0;
+}
+
+/* True if the functional or alias was compiled. The tests return early
+   without the functionals they use */
+int compiled(const char * name) {
+  auto fun = xcfun_new();
+  int ok = xcfun_set(fun, name, 1.0) == 0;
+  xcfun_delete(fun);
+  return ok;
+}
+
 int main() {
   int i = 0;
   const char *n, *s;
+  if (selective_build())
+    printf("Selective build, the tests skip the functionals left out\n");
   consistency_test();
   gradient_forms_test();
+  alpha_vars_test();
   user_setup_test();
   xcfun_get_test();
+  lda_table_test();
+  vector_math_test();
+  single_precision_test();
+  profile_test();
+  strided_eval_test();
+  try_eval_test();
+  output_mask_test();
+  spin_symmetry_test();
+  planes_test();
+  kernel_contraction_test();
+  integrate_test();
+  weighted_eval_test();
+  adjoint_test();
+  hessian_vector_test();
+  generated_kernels_test();
+  jit_test();
+  term_weights_test();
+  workspace_test();
   printf("%s", xcfun_splash());
   printf("XCFun version: %s\n", xcfun_version());
+  printf("Kernel instruction set: %s\n", xcfun_kernel_isa());
   printf("\nAvailable functionals and other settings:\n");
   while ((n = xcfun_enumerate_parameters(i++))) {
     printf("%s \t", n);
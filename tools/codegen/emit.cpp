@@ -0,0 +1,327 @@
+/*
+ * XCFun, an arbitrary order exchange-correlation library
+ * Copyright (C) 2020 Ulf Ekström and contributors.
+ *
+ * This file is part of XCFun.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * For information on the complete list of contributors to the
+ * XCFun library, see: <https://xcfun.readthedocs.io/>
+ */
+
+#include "emit.hpp"
+
+#include <map>
+#include <tuple>
+
+constexpr codegen_vars_data codegen_vars[CODEGEN_NR_VARS] = {
+    {XC_N, 1, XC_DENSITY},
+    {XC_A_B, 2, XC_DENSITY},
+    {XC_N_GNN, 2, XC_DENSITY | XC_GRADIENT},
+    {XC_A_B_GAA_GAB_GBB, 5, XC_DENSITY | XC_GRADIENT},
+    {XC_N_GNN_TAUN, 3, XC_DENSITY | XC_GRADIENT | XC_KINETIC},
+    {XC_A_B_GAA_GAB_GBB_TAUA_TAUB, 7, XC_DENSITY | XC_GRADIENT | XC_KINETIC},
+};
+
+// Longest input of codegen_vars from the i-th on
+static constexpr int codegen_max_len(int i) {
+  return i == CODEGEN_NR_VARS ? 0
+         : codegen_vars[i].len > codegen_max_len(i + 1) ? codegen_vars[i].len
+                                                         : codegen_max_len(i + 1);
+}
+
+static_assert(CODEGEN_MAX_ORDER <= XCINT_GENERATED_MAX_ORDER &&
+                  codegen_max_len(0) <= XCINT_GENERATED_MAX_INVARS,
+              "the kernels overflow the output buffer of xcint_eval_generated()");
+
+const codegen_functional_data * codegen_funs[XC_NR_FUNCTIONALS];
+const char * codegen_symbols[XC_NR_FUNCTIONALS];
+
+template <int FUN, int SPAN> struct codegen_helper {
+  static void doit() {
+    codegen_helper<FUN, SPAN / 2>::doit();
+    codegen_helper<FUN + SPAN / 2, (SPAN + 1) / 2>::doit();
+  }
+};
+
+template <int FUN> struct codegen_helper<FUN, 1> {
+  static void doit() {
+    codegen_funs[FUN] = &codegen_fundat_db<FUN>::d;
+    codegen_symbols[FUN] = codegen_fundat_db<FUN>::symbol;
+  }
+};
+
+void codegen_setup_functionals() { codegen_helper<0, XC_NR_FUNCTIONALS>::doit(); }
+
+namespace codegen {
+// d node / d argument i of the node
+static int partial(graph & g, int n, int i) {
+  node x = g.nodes[n];
+  switch (x.op) {
+    case OP_ADD:
+    case OP_REG:
+      return g.constant(1);
+    case OP_SUB:
+      return g.constant(i == 0 ? 1 : -1);
+    case OP_NEG:
+      return g.constant(-1);
+    case OP_MUL:
+      return i == 0 ? x.b : x.a;
+    case OP_DIV:
+      // d(a/b)/db = -(a/b)/b
+      return i == 0 ? g.div(g.constant(1), x.b) : g.neg(g.div(n, x.b));
+    case OP_FUN:
+      return g.fun(x.fun, x.k + 1, x.a, x.param);
+    default:
+      xcfun::die("codegen: no partial derivative", x.op);
+      return -1;
+  }
+}
+
+// Derivatives of y with respect to the inputs, by a backward sweep
+static std::vector<int> gradient(graph & g, int y, int inlen) {
+  std::vector<int> adj(y + 1, -1);
+  adj[y] = g.constant(1);
+  for (int n = y; n >= 0; n--) {
+    if (adj[n] < 0)
+      continue;
+    node x = g.nodes[n];
+    int args[2] = {x.a, x.b};
+    for (int i = 0; i < 2; i++) {
+      if (args[i] < 0)
+        continue;
+      int d = g.mul(adj[n], partial(g, n, i));
+      adj[args[i]] = adj[args[i]] < 0 ? d : g.add(adj[args[i]], d);
+    }
+  }
+  std::vector<int> grad(inlen, g.constant(0));
+  for (int n = 0; n <= y; n++)
+    if (g.nodes[n].op == OP_INPUT && adj[n] >= 0)
+      grad[g.nodes[n].k] = adj[n];
+  return grad;
+}
+
+// Derivatives of the nodes ys with respect to input j, by a forward sweep
+static std::vector<int> tangent(graph & g, const std::vector<int> & ys, int j) {
+  int last = 0;
+  for (int y : ys)
+    last = y > last ? y : last;
+  std::vector<int> dot(last + 1);
+  for (int n = 0; n <= last; n++) {
+    node x = g.nodes[n];
+    if (x.op == OP_CONST) {
+      dot[n] = g.constant(0);
+    } else if (x.op == OP_INPUT) {
+      dot[n] = g.constant(x.k == j ? 1 : 0);
+    } else {
+      // Partials are only added to the graph where they are needed
+      int d = g.constant(0);
+      if (!g.is_const(dot[x.a], 0))
+        d = g.mul(dot[x.a], partial(g, n, 0));
+      if (x.b >= 0 && !g.is_const(dot[x.b], 0))
+        d = g.add(d, g.mul(dot[x.b], partial(g, n, 1)));
+      dot[n] = d;
+    }
+  }
+  std::vector<int> res;
+  for (int y : ys)
+    res.push_back(dot[y]);
+  return res;
+}
+
+// Outputs in the layout of XC_PARTIAL_DERIVATIVES
+std::vector<int> partial_derivatives(graph & g, int y, int inlen, int order) {
+  std::vector<int> out(1, y);
+  if (order < 1)
+    return out;
+  std::vector<int> grad = gradient(g, y, inlen);
+  out.insert(out.end(), grad.begin(), grad.end());
+  if (order < 2)
+    return out;
+  std::vector<std::vector<int>> hess;
+  for (int j = 0; j < inlen; j++)
+    hess.push_back(tangent(g, grad, j));
+  for (int i = 0; i < inlen; i++)
+    for (int j = i; j < inlen; j++)
+      out.push_back(hess[j][i]);
+  return out;
+}
+
+static const char * fun_name(fun_t f) {
+  switch (f) {
+    case FUN_EXP:
+      return "exp_expand";
+    case FUN_EXPM1:
+      return "codegen::expm1_expand";
+    case FUN_LOG:
+      return "log_expand";
+    case FUN_SQRT:
+      return "sqrt_expand";
+    case FUN_CBRT:
+      return "cbrt_expand";
+    case FUN_POW:
+      return "pow_expand";
+    case FUN_ATAN:
+      return "atan_expand";
+    case FUN_ERF:
+      return "erf_expand";
+    case FUN_SIN:
+      return "sin_expand";
+    case FUN_COS:
+      return "cos_expand";
+    case FUN_ASIN:
+      return "asin_expand";
+    case FUN_ACOS:
+      return "acos_expand";
+    case FUN_ASINH:
+      return "asinh_expand";
+    case FUN_SQRTX_ASINH_SQRTX:
+      return "codegen::sqrtx_asinh_sqrtx_expand";
+    default:
+      xcfun::die("codegen: unknown function", f);
+      return nullptr;
+  }
+}
+
+static std::string number(double x) {
+  char buf[40];
+  std::snprintf(buf, sizeof(buf), x < 0 ? "(%.17g)" : "%.17g", x);
+  return buf;
+}
+
+static std::string operand(const graph & g, int n) {
+  const node & x = g.nodes[n];
+  if (x.op == OP_CONST)
+    return number(x.param);
+  if (x.op == OP_INPUT)
+    return "d[" + std::to_string(x.k) + "]";
+  return "v" + std::to_string(n);
+}
+
+// Writes the kernel computing the nodes out. Returns false, writing
+// nothing, if a constant is not finite.
+bool emit_kernel(std::FILE * f,
+                 const graph & g,
+                 const std::string & name,
+                 const std::vector<int> & out) {
+  std::vector<char> live(g.nodes.size(), 0);
+  for (int y : out)
+    live[y] = 1;
+  for (int n = static_cast<int>(g.nodes.size()) - 1; n >= 0; n--)
+    if (live[n]) {
+      if (g.nodes[n].op == OP_CONST && !std::isfinite(g.nodes[n].param))
+        return false;
+      if (g.nodes[n].a >= 0)
+        live[g.nodes[n].a] = 1;
+      if (g.nodes[n].b >= 0)
+        live[g.nodes[n].b] = 1;
+    }
+  // Derivatives of one function at one argument come from one expansion
+  typedef std::tuple<int, int, double> series;
+  std::map<series, int> degree, expansion;
+  for (size_t n = 0; n < g.nodes.size(); n++) {
+    const node & x = g.nodes[n];
+    if (live[n] && x.op == OP_FUN) {
+      series s(x.fun, x.a, x.param);
+      if (!degree.count(s) || degree[s] < x.k)
+        degree[s] = x.k;
+    }
+  }
+  int ops = 0;
+  for (size_t n = 0; n < g.nodes.size(); n++)
+    ops += live[n] && g.nodes[n].op > OP_INPUT;
+  std::fprintf(f, "\n// %d operations\n", ops);
+  std::fprintf(f,
+               "void %s(double w, const double d[], double out[]) {\n",
+               name.c_str());
+  for (size_t n = 0; n < g.nodes.size(); n++) {
+    if (!live[n])
+      continue;
+    const node & x = g.nodes[n];
+    std::string v = "v" + std::to_string(n), a, b;
+    if (x.a >= 0)
+      a = operand(g, x.a);
+    if (x.b >= 0)
+      b = operand(g, x.b);
+    switch (x.op) {
+      case OP_CONST:
+      case OP_INPUT:
+        break;
+      case OP_ADD:
+        std::fprintf(
+            f, "  const double %s = %s + %s;\n", v.c_str(), a.c_str(), b.c_str());
+        break;
+      case OP_SUB:
+        std::fprintf(
+            f, "  const double %s = %s - %s;\n", v.c_str(), a.c_str(), b.c_str());
+        break;
+      case OP_MUL:
+        std::fprintf(
+            f, "  const double %s = %s * %s;\n", v.c_str(), a.c_str(), b.c_str());
+        break;
+      case OP_DIV:
+        std::fprintf(
+            f, "  const double %s = %s / %s;\n", v.c_str(), a.c_str(), b.c_str());
+        break;
+      case OP_NEG:
+        std::fprintf(f, "  const double %s = -%s;\n", v.c_str(), a.c_str());
+        break;
+      case OP_REG: {
+        std::string tiny = number(xcfun::XCFUN_TINY_DENSITY);
+        std::fprintf(f,
+                     "  const double %s = %s < %s ? %s : %s;\n",
+                     v.c_str(),
+                     a.c_str(),
+                     tiny.c_str(),
+                     tiny.c_str(),
+                     a.c_str());
+      } break;
+      case OP_FUN: {
+        series s(x.fun, x.a, x.param);
+        if (!expansion.count(s)) {
+          int t = static_cast<int>(expansion.size());
+          expansion[s] = t;
+          std::fprintf(f, "  double t%d[%d];\n", t, degree[s] + 1);
+          if (x.fun == FUN_POW)
+            std::fprintf(f,
+                         "  %s<double, %d>(t%d, %s, %s);\n",
+                         fun_name(x.fun),
+                         degree[s],
+                         t,
+                         a.c_str(),
+                         number(x.param).c_str());
+          else
+            std::fprintf(f,
+                         "  %s<double, %d>(t%d, %s);\n",
+                         fun_name(x.fun),
+                         degree[s],
+                         t,
+                         a.c_str());
+        }
+        // The k:th derivative is k! times the Taylor coefficient
+        double fac = 1;
+        for (int i = 2; i <= x.k; i++)
+          fac *= i;
+        if (fac == 1)
+          std::fprintf(
+              f, "  const double %s = t%d[%d];\n", v.c_str(), expansion[s], x.k);
+        else
+          std::fprintf(f,
+                       "  const double %s = %s * t%d[%d];\n",
+                       v.c_str(),
+                       number(fac).c_str(),
+                       expansion[s],
+                       x.k);
+      } break;
+    }
+  }
+  for (size_t k = 0; k < out.size(); k++)
+    if (!g.is_const(out[k], 0))
+      std::fprintf(f, "  out[%d] += w * %s;\n", int(k), operand(g, out[k]).c_str());
+  std::fprintf(f, "}\n");
+  return true;
+}
+} // namespace codegen
@@ -0,0 +1,61 @@
+/*
+ * XCFun, an arbitrary order exchange-correlation library
+ * Copyright (C) 2020 Ulf Ekström and contributors.
+ *
+ * This file is part of XCFun.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * For information on the complete list of contributors to the
+ * XCFun library, see: <https://xcfun.readthedocs.io/>
+ */
+
+#pragma once
+
+/*
+  Partial derivatives of traced graphs, and their kernels as C++ source.
+  Shared by the generator and the run time compiled kernels of xcint_jit.cpp.
+  The gradient comes from a backward sweep over the graph and the second
+  derivatives from a forward sweep for each variable over the gradient.
+*/
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "xcint.hpp"
+
+// Partial derivatives are generated up to this order
+#define CODEGEN_MAX_ORDER 2
+#define CODEGEN_NR_VARS 6
+
+// Vars kernels are generated for, the ones of XC_PARTIAL_DERIVATIVES with
+// densities and their gradients and kinetic energy densities
+struct codegen_vars_data {
+  xcfun_vars vars;
+  int len;
+  int provides;
+};
+
+extern const codegen_vars_data codegen_vars[CODEGEN_NR_VARS];
+
+// The functionals compiled with XCFUN_CODEGEN, after codegen_setup_functionals()
+extern const codegen_functional_data * codegen_funs[XC_NR_FUNCTIONALS];
+extern const char * codegen_symbols[XC_NR_FUNCTIONALS];
+void codegen_setup_functionals();
+
+namespace codegen {
+// Nodes of the partial derivatives of y up to order, in the layout of
+// XC_PARTIAL_DERIVATIVES
+std::vector<int> partial_derivatives(graph & g, int y, int inlen, int order);
+
+// Writes the kernel name, of type xcint_generated_fn, adding w times the
+// nodes out to its output. Returns false, writing nothing, if a constant is
+// not finite.
+bool emit_kernel(std::FILE * f,
+                 const graph & g,
+                 const std::string & name,
+                 const std::vector<int> & out);
+} // namespace codegen
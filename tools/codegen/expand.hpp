@@ -0,0 +1,49 @@
+/*
+ * XCFun, an arbitrary order exchange-correlation library
+ * Copyright (C) 2020 Ulf Ekström and contributors.
+ *
+ * This file is part of XCFun.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * For information on the complete list of contributors to the
+ * XCFun library, see: <https://xcfun.readthedocs.io/>
+ */
+
+#pragma once
+
+/*
+  Taylor series of the elementary functions without an _expand in
+  tmath.hpp, used by the generated kernels and for folding constants in
+  the generator. Both give the same numbers as the ctaylor functions.
+*/
+
+#include "ctaylor.hpp"
+#include "tmath.hpp"
+
+namespace codegen {
+// exp(x)-1, with the constant term accurate for small x as in ctaylor
+template <class T, int N> static void expm1_expand(T * t, const T & x0) {
+  exp_expand<T, N>(t, x0);
+  if (fabs(x0) > 1e-3)
+    t[0] -= 1;
+  else
+    t[0] = 2 * exp(x0 / 2) * sinh(x0 / 2);
+}
+
+// Through ctaylor, which switches to a Pade approximation near 0. With all
+// variables set the coefficient of VAR0..VAR(i-1) is the i:th derivative.
+template <class T, int N> static void sqrtx_asinh_sqrtx_expand(T * t, const T & x0) {
+  ctaylor<T, N> x(x0);
+  for (int i = 0; i < N; i++)
+    x.set(1 << i, 1);
+  x = sqrtx_asinh_sqrtx(x);
+  T fac = 1;
+  for (int i = 0; i <= N; i++) {
+    t[i] = x.c[(1 << i) - 1] / fac;
+    fac *= i + 1;
+  }
+}
+} // namespace codegen
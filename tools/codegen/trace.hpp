@@ -0,0 +1,423 @@
+/*
+ * XCFun, an arbitrary order exchange-correlation library
+ * Copyright (C) 2020 Ulf Ekström and contributors.
+ *
+ * This file is part of XCFun.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * For information on the complete list of contributors to the
+ * XCFun library, see: <https://xcfun.readthedocs.io/>
+ */
+
+#pragma once
+
+/*
+  Tracing number type of the kernel generator. An expr is the index of a
+  node in the active graph, and operations on exprs add nodes instead of
+  computing values. Evaluating a functional template with num =
+  codegen::expr thus records its expression DAG. Nodes are hash-consed,
+  which merges common subexpressions as the graph grows, and operations
+  on constants are folded. Derivatives are nodes too, so that the
+  generator can differentiate the graph with the same machinery.
+
+  Elementary functions are FUN nodes holding the k:th derivative of the
+  function at the argument, with the exponent of pow in param. Their
+  values come from the _expand functions, as in ctaylor.
+
+  Data dependent control flow cannot be traced. Comparisons involving a
+  traced value mark the graph as branched, and graphs that read run time
+  parameters as parametric. The generator leaves both out, and also
+  leaves out singular graphs, which divide by zero for some variables.
+*/
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "config.hpp"
+#include "expand.hpp"
+
+namespace codegen {
+enum op_t {
+  OP_CONST,
+  OP_INPUT,
+  OP_ADD,
+  OP_SUB,
+  OP_MUL,
+  OP_DIV,
+  OP_NEG,
+  OP_REG,
+  OP_FUN
+};
+
+enum fun_t {
+  FUN_NONE,
+  FUN_EXP,
+  FUN_EXPM1,
+  FUN_LOG,
+  FUN_SQRT,
+  FUN_CBRT,
+  FUN_POW,
+  FUN_ATAN,
+  FUN_ERF,
+  FUN_SIN,
+  FUN_COS,
+  FUN_ASIN,
+  FUN_ACOS,
+  FUN_ASINH,
+  FUN_SQRTX_ASINH_SQRTX
+};
+
+// Highest derivative of a FUN node, enough for kernels of order 2 and the
+// derivative of their last level
+#define CODEGEN_MAX_DERIVATIVE 3
+
+struct node {
+  op_t op;
+  int a, b;     // Arguments, -1 if unused
+  fun_t fun;    // OP_FUN
+  int k;        // Derivative of OP_FUN, variable of OP_INPUT
+  double param; // Value of OP_CONST, exponent of FUN_POW
+};
+
+// k:th derivative of f at x
+template <int K> double derivative(fun_t f, double x, double p) {
+  double t[K + 1];
+  switch (f) {
+    case FUN_EXP:
+      exp_expand<double, K>(t, x);
+      break;
+    case FUN_EXPM1:
+      expm1_expand<double, K>(t, x);
+      break;
+    case FUN_LOG:
+      log_expand<double, K>(t, x);
+      break;
+    case FUN_SQRT:
+      sqrt_expand<double, K>(t, x);
+      break;
+    case FUN_CBRT:
+      cbrt_expand<double, K>(t, x);
+      break;
+    case FUN_POW:
+      pow_expand<double, K>(t, x, p);
+      break;
+    case FUN_ATAN:
+      atan_expand<double, K>(t, x);
+      break;
+    case FUN_ERF:
+      erf_expand<double, K>(t, x);
+      break;
+    case FUN_SIN:
+      sin_expand<double, K>(t, x);
+      break;
+    case FUN_COS:
+      cos_expand<double, K>(t, x);
+      break;
+    case FUN_ASIN:
+      asin_expand<double, K>(t, x);
+      break;
+    case FUN_ACOS:
+      acos_expand<double, K>(t, x);
+      break;
+    case FUN_ASINH:
+      asinh_expand<double, K>(t, x);
+      break;
+    case FUN_SQRTX_ASINH_SQRTX:
+      sqrtx_asinh_sqrtx_expand<double, K>(t, x);
+      break;
+    default:
+      xcfun::die("codegen: unknown function", f);
+  }
+  double fac = 1;
+  for (int i = 2; i <= K; i++)
+    fac *= i;
+  return fac * t[K];
+}
+
+inline double derivative(fun_t f, int k, double x, double p) {
+  switch (k) {
+    case 0:
+      return derivative<0>(f, x, p);
+    case 1:
+      return derivative<1>(f, x, p);
+    case 2:
+      return derivative<2>(f, x, p);
+    case 3:
+      return derivative<3>(f, x, p);
+    default:
+      xcfun::die("codegen: derivative order too high", k);
+      return 0;
+  }
+}
+
+struct graph {
+  std::vector<node> nodes;
+  bool branched{false};
+  bool parametric{false};
+  bool singular{false};
+  // Parameters are constants of the trace, as for the kernels compiled at
+  // run time, instead of making it parametric
+  bool fixed_parameters{false};
+
+  bool is_const(int i) const { return nodes[i].op == OP_CONST; }
+  bool is_const(int i, double x) const {
+    return nodes[i].op == OP_CONST && nodes[i].param == x;
+  }
+  double value(int i) const { return nodes[i].param; }
+
+  int constant(double x) {
+    if (!std::isfinite(x))
+      singular = true;
+    return make(OP_CONST, -1, -1, FUN_NONE, 0, x);
+  }
+  int input(int i) { return make(OP_INPUT, -1, -1, FUN_NONE, i, 0); }
+  int add(int a, int b) {
+    if (is_const(a) && is_const(b))
+      return constant(value(a) + value(b));
+    if (is_const(a, 0))
+      return b;
+    if (is_const(b, 0))
+      return a;
+    if (nodes[b].op == OP_NEG)
+      return sub(a, nodes[b].a);
+    if (nodes[a].op == OP_NEG)
+      return sub(b, nodes[a].a);
+    return make(OP_ADD, a < b ? a : b, a < b ? b : a, FUN_NONE, 0, 0);
+  }
+  int sub(int a, int b) {
+    if (is_const(a) && is_const(b))
+      return constant(value(a) - value(b));
+    if (is_const(b, 0))
+      return a;
+    if (is_const(a, 0))
+      return neg(b);
+    if (a == b)
+      return constant(0);
+    if (nodes[b].op == OP_NEG)
+      return add(a, nodes[b].a);
+    return make(OP_SUB, a, b, FUN_NONE, 0, 0);
+  }
+  int mul(int a, int b) {
+    if (is_const(a) && is_const(b))
+      return constant(value(a) * value(b));
+    if (is_const(a, 0) || is_const(b, 0))
+      return constant(0);
+    if (is_const(a, 1))
+      return b;
+    if (is_const(b, 1))
+      return a;
+    if (is_const(a, -1))
+      return neg(b);
+    if (is_const(b, -1))
+      return neg(a);
+    return make(OP_MUL, a < b ? a : b, a < b ? b : a, FUN_NONE, 0, 0);
+  }
+  int div(int a, int b) {
+    if (is_const(a) && is_const(b))
+      return constant(value(a) / value(b));
+    if (is_const(a, 0))
+      return constant(0);
+    if (is_const(b, 1))
+      return a;
+    if (is_const(b, 0))
+      singular = true;
+    return make(OP_DIV, a, b, FUN_NONE, 0, 0);
+  }
+  int neg(int a) {
+    if (is_const(a))
+      return constant(-value(a));
+    if (nodes[a].op == OP_NEG)
+      return nodes[a].a;
+    return make(OP_NEG, a, -1, FUN_NONE, 0, 0);
+  }
+  // Density regularization, see densvars.hpp. The derivative is 1 also
+  // below the threshold, as for ctaylor.
+  int reg(int a) {
+    if (is_const(a))
+      return constant(value(a) < xcfun::XCFUN_TINY_DENSITY
+                          ? xcfun::XCFUN_TINY_DENSITY
+                          : value(a));
+    return make(OP_REG, a, -1, FUN_NONE, 0, 0);
+  }
+  int fun(fun_t f, int k, int a, double p = 0) {
+    if (k > CODEGEN_MAX_DERIVATIVE)
+      xcfun::die("codegen: derivative order too high", k);
+    if (is_const(a))
+      return constant(derivative(f, k, value(a), p));
+    return make(OP_FUN, a, -1, f, k, p);
+  }
+  // False, and the graph is branched, unless both are constants
+  bool branch(int a, int b) {
+    if (!(is_const(a) && is_const(b)))
+      branched = true;
+    return is_const(a) && is_const(b);
+  }
+
+private:
+  typedef std::tuple<int, int, int, int, int, std::uint64_t> key;
+  std::map<key, int> index;
+
+  int make(op_t op, int a, int b, fun_t f, int k, double param) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &param, sizeof(bits));
+    key id(op, a, b, f, k, bits);
+    auto it = index.find(id);
+    if (it != index.end())
+      return it->second;
+    node n = {op, a, b, f, k, param};
+    nodes.push_back(n);
+    int i = static_cast<int>(nodes.size()) - 1;
+    index[id] = i;
+    return i;
+  }
+};
+
+// The graph new exprs go to
+inline graph *& active() {
+  static graph * g = nullptr;
+  return g;
+}
+
+struct expr {
+  int id;
+
+  expr() : id(active()->constant(0)) {}
+  expr(double x) : id(active()->constant(x)) {}
+  static expr node(int i) {
+    expr e;
+    e.id = i;
+    return e;
+  }
+  template <class S> expr & operator+=(const S & x) { return *this = *this + x; }
+  template <class S> expr & operator-=(const S & x) { return *this = *this - x; }
+  template <class S> expr & operator*=(const S & x) { return *this = *this * x; }
+  template <class S> expr & operator/=(const S & x) { return *this = *this / x; }
+};
+
+inline expr operator-(const expr & x) { return expr::node(active()->neg(x.id)); }
+
+#define CODEGEN_BINARY(OP, F)                                                       \
+  inline expr operator OP(const expr & x, const expr & y) {                         \
+    return expr::node(active()->F(x.id, y.id));                                     \
+  }                                                                                 \
+  inline expr operator OP(const expr & x, double y) { return x OP expr(y); }        \
+  inline expr operator OP(double x, const expr & y) { return expr(x) OP y; }
+CODEGEN_BINARY(+, add)
+CODEGEN_BINARY(-, sub)
+CODEGEN_BINARY(*, mul)
+CODEGEN_BINARY(/, div)
+#undef CODEGEN_BINARY
+
+#define CODEGEN_COMPARE(OP)                                                         \
+  inline bool operator OP(const expr & x, const expr & y) {                         \
+    graph * g = active();                                                           \
+    return g->branch(x.id, y.id) && g->value(x.id) OP g->value(y.id);               \
+  }                                                                                 \
+  inline bool operator OP(const expr & x, double y) { return x OP expr(y); }        \
+  inline bool operator OP(double x, const expr & y) { return expr(x) OP y; }
+CODEGEN_COMPARE(<)
+CODEGEN_COMPARE(>)
+CODEGEN_COMPARE(<=)
+CODEGEN_COMPARE(>=)
+CODEGEN_COMPARE(==)
+CODEGEN_COMPARE(!=)
+#undef CODEGEN_COMPARE
+
+#define CODEGEN_FUNCTION(F, FUN)                                                    \
+  inline expr F(const expr & x) { return expr::node(active()->fun(FUN, 0, x.id)); }
+CODEGEN_FUNCTION(exp, FUN_EXP)
+CODEGEN_FUNCTION(expm1, FUN_EXPM1)
+CODEGEN_FUNCTION(log, FUN_LOG)
+CODEGEN_FUNCTION(sqrt, FUN_SQRT)
+CODEGEN_FUNCTION(cbrt, FUN_CBRT)
+CODEGEN_FUNCTION(atan, FUN_ATAN)
+CODEGEN_FUNCTION(erf, FUN_ERF)
+CODEGEN_FUNCTION(sin, FUN_SIN)
+CODEGEN_FUNCTION(cos, FUN_COS)
+CODEGEN_FUNCTION(asin, FUN_ASIN)
+CODEGEN_FUNCTION(acos, FUN_ACOS)
+CODEGEN_FUNCTION(asinh, FUN_ASINH)
+CODEGEN_FUNCTION(sqrtx_asinh_sqrtx, FUN_SQRTX_ASINH_SQRTX)
+#undef CODEGEN_FUNCTION
+
+inline expr pow(const expr & x, double a) {
+  return expr::node(active()->fun(FUN_POW, 0, x.id, a));
+}
+
+// Products for positive integers, as for ctaylor
+inline expr pow(const expr & x, int n) {
+  if (n > 0) {
+    expr res = x;
+    while (n-- > 1)
+      res *= x;
+    return res;
+  } else if (n < 0) {
+    return pow(x, double(n));
+  } else {
+    return expr(1);
+  }
+}
+
+inline expr abs(const expr & x) {
+  if (x < 0)
+    return -x;
+  else
+    return x;
+}
+
+inline expr fabs(const expr & x) { return abs(x); }
+
+inline expr min(const expr & a, const expr & b) {
+  if (a <= b)
+    return a;
+  else
+    return b;
+}
+
+inline expr max(const expr & a, const expr & b) {
+  if (a > b)
+    return a;
+  else
+    return b;
+}
+
+inline void regularize(expr & x) { x = expr::node(active()->reg(x.id)); }
+
+// Functions of the library that have no expression, such as the iterative
+// solver of Becke-Roussel. Marks the graph as branched.
+inline expr untraceable(const expr & x) {
+  active()->branched = true;
+  return x;
+}
+
+// Powers x^(k/3) with the arithmetic of tpow_thirds
+struct thirds {
+  expr inv, x0;
+  expr root[3];
+
+  thirds() = default;
+  explicit thirds(const expr & x) : inv(1 / x), x0(x) {
+    root[0] = 1;
+    root[1] = cbrt(x);
+    root[2] = root[1] * root[1];
+  }
+  expr operator()(int k) const {
+    int q = (k >= 0) ? k / 3 : -((2 - k) / 3); // Rounded down
+    expr res = root[k - 3 * q];
+    for (; q > 0; q--)
+      res *= x0;
+    for (; q < 0; q++)
+      res *= inv;
+    return res;
+  }
+};
+
+inline thirds pow_thirds(const expr & x) { return thirds(x); }
+} // namespace codegen
@@ -0,0 +1,168 @@
+/*
+ * XCFun, an arbitrary order exchange-correlation library
+ * Copyright (C) 2020 Ulf Ekström and contributors.
+ *
+ * This file is part of XCFun.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * For information on the complete list of contributors to the
+ * XCFun library, see: <https://xcfun.readthedocs.io/>
+ */
+
+/*
+  Generator of straight-line kernels for partial derivatives, run at
+  build time with XCFUN_ENABLE_CODEGEN. It is linked with the functionals
+  compiled for the tracing type of trace.hpp, evaluates each one on
+  symbolic inputs and writes out the partial derivatives of the resulting
+  graph with emit.hpp, as one C++ function per functional, vars and order.
+  See xcint_generated_fn.
+
+    xcfun_codegen <output directory> <functional>...
+
+  writes gen_<functional>.cpp for each functional named, and
+  xcint_generated.cpp with the table of all kernels.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "emit.hpp"
+
+using codegen::graph;
+
+// Only densvars is used, which reads vars and the parameters
+XCFunctional::XCFunctional() {}
+
+// Kernel orders the library has for partial derivatives of this order,
+// see xcint_kernels_available()
+static bool codegen_order_compiled(const codegen_functional_data & fd,
+                                   int order,
+                                   int len) {
+  int lo = order == 0 ? 0 : 2, hi = order == 0 ? 0 : 2;
+  if (order == 1 && (len & 1))
+    lo = 1;
+  return fd.min_order <= lo && hi <= fd.max_order;
+}
+
+struct kernel_entry {
+  std::string name;
+  int functional;
+  xcfun_vars vars;
+  int order;
+};
+
+int main(int argc, char * argv[]) {
+  if (argc < 2) {
+    std::fprintf(stderr, "Usage: %s <output directory> <functional>...\n", argv[0]);
+    return 1;
+  }
+  std::string dir = argv[1];
+  codegen_setup_functionals();
+  std::vector<kernel_entry> table;
+  int skipped = 0;
+  for (int arg = 2; arg < argc; arg++) {
+    int id = -1;
+    for (int i = 0; i < XC_NR_FUNCTIONALS; i++)
+      if (std::strcmp(codegen_symbols[i] + 3, argv[arg]) == 0)
+        id = i;
+    if (id < 0) {
+      std::fprintf(stderr, "Unknown functional %s\n", argv[arg]);
+      return 1;
+    }
+    std::string file = dir + "/gen_" + argv[arg] + ".cpp";
+    std::FILE * f = std::fopen(file.c_str(), "w");
+    if (!f) {
+      std::fprintf(stderr, "Cannot write %s\n", file.c_str());
+      return 1;
+    }
+    std::fprintf(f,
+                 "// Generated by xcfun_codegen from the templates of %s, do not "
+                 "edit\n\n#include \"expand.hpp\"\n",
+                 codegen_symbols[id]);
+    const codegen_functional_data & fd = *codegen_funs[id];
+    bool traceable = fd.fp != nullptr;
+    for (const auto & v : codegen_vars) {
+      if (!traceable || (fd.depends & v.provides) != fd.depends)
+        continue;
+      for (int order = 0; order <= CODEGEN_MAX_ORDER && traceable; order++) {
+        if (!codegen_order_compiled(fd, order, v.len))
+          continue;
+        graph g;
+        codegen::active() = &g;
+        XCFunctional fun;
+        fun.vars = v.vars;
+        codegen::expr in[XC_MAX_INVARS];
+        for (int i = 0; i < v.len; i++)
+          in[i] = codegen::expr::node(g.input(i));
+        densvars<codegen::expr> d(&fun, in);
+        int y = fd.fp(d).id;
+        codegen::active() = nullptr;
+        if (g.branched || g.parametric) {
+          std::fprintf(f,
+                       "\n// Not generated, %s\n",
+                       g.branched ? "branches on the density" : "reads parameters");
+          traceable = false;
+          skipped++;
+          break;
+        }
+        if (g.singular) {
+          std::fprintf(
+              f, "\n// Not generated for vars %d, divides by zero\n", int(v.vars));
+          break;
+        }
+        kernel_entry k = {std::string("xcint_gen_") + argv[arg] + "_" +
+                              std::to_string(int(v.vars)) + "_" +
+                              std::to_string(order),
+                          id,
+                          v.vars,
+                          order};
+        if (codegen::emit_kernel(
+                f, g, k.name, codegen::partial_derivatives(g, y, v.len, order)))
+          table.push_back(k);
+      }
+    }
+    std::fclose(f);
+  }
+  std::string file = dir + "/xcint_generated.cpp";
+  std::FILE * f = std::fopen(file.c_str(), "w");
+  if (!f) {
+    std::fprintf(stderr, "Cannot write %s\n", file.c_str());
+    return 1;
+  }
+  std::fprintf(
+      f, "// Generated by xcfun_codegen, do not edit\n\n#include \"xcint.hpp\"\n\n");
+  for (const auto & k : table)
+    std::fprintf(
+        f, "void %s(double w, const double d[], double out[]);\n", k.name.c_str());
+  std::fprintf(f,
+               "\nstatic const struct {\n  int functional;\n  xcfun_vars vars;\n"
+               "  int order;\n  xcint_generated_fn kernel;\n} kernels[] = {\n");
+  for (const auto & k : table)
+    std::fprintf(f,
+                 "    {%d, static_cast<xcfun_vars>(%d), %d, %s},\n",
+                 k.functional,
+                 int(k.vars),
+                 k.order,
+                 k.name.c_str());
+  std::fprintf(f, "    {-1, XC_VARS_UNSET, 0, nullptr}};\n");
+  std::fprintf(f,
+               "\nxcint_generated_fn xcint_generated_kernel(int functional_id,\n"
+               "                                          xcfun_vars vars,\n"
+               "                                          int order) {\n"
+               "  for (int i = 0; kernels[i].kernel; i++)\n"
+               "    if (kernels[i].functional == functional_id && "
+               "kernels[i].vars == vars &&\n"
+               "        kernels[i].order == order)\n"
+               "      return kernels[i].kernel;\n"
+               "  return nullptr;\n}\n");
+  std::fclose(f);
+  std::printf("Generated %d kernels, %d functionals not traceable\n",
+              int(table.size()),
+              skipped);
+  return 0;
+}